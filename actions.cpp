@@ -0,0 +1,71 @@
+#include <cstdio>
+#include "actions.h"
+#include "game.h"
+
+using namespace std;
+
+// Steps after which an action graph that has not finished counts as stuck.
+static const int ACTION_CHECK_MAX_STEPS = TICK_RATE * 10;
+
+// Counts the on_finish calls made while its action runs.
+class check_sprite_t : public sprite_t {
+public:
+    int graph_finishes = 0;
+    int child_finishes = 0;
+};
+
+static void on_graph_finished(void* ent, action_t*) {
+    ((check_sprite_t*)ent)->graph_finishes++;
+}
+
+static void on_child_finished(void* ent, action_t*) {
+    ((check_sprite_t*)ent)->child_finishes++;
+}
+
+template<typename T>
+static T finishing(T action, action_callback_t on_finish) {
+    action.on_finish = on_finish;
+    return action;
+}
+
+// Runs action to completion on a sprite of its own. It must finish once
+// and call its children's on_finish children times.
+static bool check(const char* name, action_t* action, int children) {
+    check_sprite_t sprite;
+    sprite.set_action(action, true);
+
+    int steps = 0;
+    while (sprite.action != nullptr && steps < ACTION_CHECK_MAX_STEPS) {
+        sprite.update(1.0f / TICK_RATE);
+        steps++;
+    }
+
+    bool is_ok = sprite.action == nullptr && sprite.graph_finishes == 1 && sprite.child_finishes == children;
+    printf("  %-9s %s after %d steps, %d of %d child finishes\n", name, is_ok ? "ok" : "FAILED", steps,
+        sprite.child_finishes, children);
+    return is_ok;
+}
+
+int run_action_check() {
+    wait_t child = finishing(wait_t(0.1f), on_child_finished);
+    wait_t longer = finishing(wait_t(0.2f), on_child_finished);
+
+    printf("actions:\n");
+    bool is_ok = true;
+    is_ok &= check("wait", make_action(finishing(wait_t(0.1f), on_graph_finished)), 0);
+    is_ok &= check("sequence", make_action(finishing(sequence_t<wait_t, wait_t>(child, longer), on_graph_finished)), 2);
+    is_ok &= check("parallel", make_action(finishing(parallel_t<wait_t, wait_t>(child, longer), on_graph_finished)), 2);
+    is_ok &= check("repeat", make_action(finishing(repeat_t<wait_t>(child, 3), on_graph_finished)), 3);
+
+    // The falling tile's graph, with the rattle's pauses counted.
+    Vector3 start = {0, 0, 0}, jolted = {0, 0, TILE_JOLT};
+    is_ok &= check("tile fall", make_action(finishing(tile_fall_t(
+        linear_move(start, (Vector3){0, 0, 512.0f}, TILE_FALL_TIME, TILE_FALL_DELAY),
+        repeat_t<tile_rattle_t>(tile_rattle_t(
+            linear_move(start, jolted, TILE_JOLT_TIME),
+            linear_move(jolted, start, TILE_JOLT_TIME),
+            finishing(wait_t(TILE_RATTLE_PAUSE), on_child_finished)
+        ), TILE_RATTLES)
+    ), on_graph_finished)), TILE_RATTLES);
+    return is_ok ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstdint>
+#include <tuple>
+#include <utility>
+#include "baseclasses.h"
+
+// Composable actions. Children are held by value, so a whole graph such as
+// sequence_t(parallel_t(a, b), wait_t(1.0f), c) is one object and is built
+// with a single allocation through make_action. Running it never allocates.
+//
+// Children's on_finish callbacks are called by their parent when the child
+// completes. They must not replace the sprite's action, which is the graph
+// itself; the graph's own on_finish is the place for that.
+
+template<typename T>
+T* make_action(T&& action) {
+    return new T(std::forward<T>(action));
+}
+
+template<typename T>
+void finish_child(void* ent, T& child) {
+    if (child.on_finish != nullptr) {
+        child.on_finish(ent, &child);
+    }
+}
+
+class wait_t : public action_t, public pooled_t<wait_t> {
+public:
+    float accum = 0.0f;
+    float time;
+
+    wait_t(float time) : time(time) {}
+
+    bool is_finished() override {
+        return accum >= time;
+    }
+
+    void step(void*, float dt) override {
+        accum += dt;
+    }
+
+    void reset() override {
+        accum = 0.0f;
+    }
+};
+
+// Runs the children one after another, each starting on the step after the
+// previous one finished.
+template<typename... Ts>
+class sequence_t : public action_t, public pooled_t<sequence_t<Ts...>> {
+public:
+    std::tuple<Ts...> children;
+    int current = 0;
+
+    sequence_t(Ts... children) : children(std::move(children)...) {}
+
+    action_t* child(int idx) {
+        return std::apply([idx](auto&... c) {
+            action_t* all[] = {&c...};
+            return all[idx];
+        }, children);
+    }
+
+    // The child currently running, or the last one once finished.
+    action_t* active() {
+        return child(current < (int)sizeof...(Ts) ? current : (int)sizeof...(Ts) - 1);
+    }
+
+    bool is_finished() override {
+        return current >= (int)sizeof...(Ts);
+    }
+
+    void step(void* ent, float dt) override {
+        if (is_finished()) {
+            return;
+        }
+
+        action_t* running = child(current);
+        running->step(ent, dt);
+        if (running->is_finished()) {
+            current++;
+            finish_child(ent, *running);
+        }
+    }
+
+    void reset() override {
+        current = 0;
+        std::apply([](auto&... c) { (c.reset(), ...); }, children);
+    }
+};
+
+// Steps all children every frame until each of them has finished.
+template<typename... Ts>
+class parallel_t : public action_t, public pooled_t<parallel_t<Ts...>> {
+    static_assert(sizeof...(Ts) <= 32, "parallel_t tracks its children in a 32 bit mask");
+public:
+    std::tuple<Ts...> children;
+    uint32_t done = 0;
+
+    parallel_t(Ts... children) : children(std::move(children)...) {}
+
+    bool is_finished() override {
+        return done == (uint32_t)((1ull << sizeof...(Ts)) - 1);
+    }
+
+    void step(void* ent, float dt) override {
+        int idx = 0;
+        std::apply([this, ent, dt, &idx](auto&... c) { (step_child(ent, dt, c, idx++), ...); }, children);
+    }
+
+    void reset() override {
+        done = 0;
+        std::apply([](auto&... c) { (c.reset(), ...); }, children);
+    }
+
+private:
+    template<typename T>
+    void step_child(void* ent, float dt, T& c, int idx) {
+        if (done & (1u << idx)) {
+            return;
+        }
+        c.step(ent, dt);
+        if (c.is_finished()) {
+            done |= 1u << idx;
+            finish_child(ent, c);
+        }
+    }
+};
+
+// Restarts the child count times, or forever when count is 0.
+template<typename T>
+class repeat_t : public action_t, public pooled_t<repeat_t<T>> {
+public:
+    T child;
+    int count;
+    int iteration = 0;
+
+    repeat_t(T child, int count = 0) : child(std::move(child)), count(count) {}
+
+    bool is_finished() override {
+        return count > 0 && iteration >= count;
+    }
+
+    void step(void* ent, float dt) override {
+        if (is_finished()) {
+            return;
+        }
+
+        child.step(ent, dt);
+        if (child.is_finished()) {
+            iteration++;
+            finish_child(ent, child);
+            if (!is_finished()) {
+                child.reset();
+            }
+        }
+    }
+
+    void reset() override {
+        iteration = 0;
+        child.reset();
+    }
+};
+
+// Runs every kind of action and the game's tile fall to completion without
+// a window and checks that each fires its on_finish callbacks. Prints the
+// results and returns 0 when all of them pass.
+int run_action_check();
@@ -0,0 +1,141 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "alloc_tracker.h"
+
+using namespace std;
+
+const char* const ALLOC_TAG_NAMES[ALLOC_TAG_COUNT] = {
+    "other", "sim", "gather", "sort", "render", "hud", "stream"
+};
+
+static thread_local alloc_tag_e current_tag = ALLOC_OTHER;
+
+// Zero before any constructor runs, so allocations during static init count.
+static atomic<uint64_t> alloc_counts[ALLOC_TAG_COUNT];
+static atomic<uint64_t> free_counts[ALLOC_TAG_COUNT];
+static atomic<int64_t> live_bytes;
+static atomic<int64_t> peak_bytes;
+
+alloc_scope_t::alloc_scope_t(alloc_tag_e tag)
+: prev(current_tag) {
+    current_tag = tag;
+}
+
+alloc_scope_t::~alloc_scope_t() {
+    current_tag = prev;
+}
+
+alloc_totals_t alloc_totals() {
+    alloc_totals_t totals;
+    for (int t = 0; t < ALLOC_TAG_COUNT; t++) {
+        totals.allocs[t] = alloc_counts[t].load(memory_order_relaxed);
+        totals.frees[t] = free_counts[t].load(memory_order_relaxed);
+    }
+    totals.live_bytes = live_bytes.load(memory_order_relaxed);
+    totals.peak_bytes = peak_bytes.load(memory_order_relaxed);
+    return totals;
+}
+
+alloc_frame_stats_t::alloc_frame_stats_t() {
+    alloc_totals_t totals = alloc_totals();
+    for (int t = 0; t < ALLOC_TAG_COUNT; t++) {
+        last[t] = totals.allocs[t];
+    }
+}
+
+void alloc_frame_stats_t::end_frame() {
+    alloc_totals_t totals = alloc_totals();
+    frame_total = 0;
+    for (int t = 0; t < ALLOC_TAG_COUNT; t++) {
+        frame[t] = totals.allocs[t] - last[t];
+        last[t] = totals.allocs[t];
+        total[t] += frame[t];
+        frame_total += frame[t];
+    }
+    clean_frames += frame_total == 0;
+    if (frames > 0 && frame_total > worst_frame) {
+        worst_frame = frame_total;
+    }
+    frames++;
+    live_bytes = totals.live_bytes;
+    peak_bytes = totals.peak_bytes;
+}
+
+#ifdef TRACK_ALLOCS
+
+// Put in front of every block, so delete knows what it releases.
+struct alignas(alignof(max_align_t)) alloc_header_t {
+    size_t size;
+    alloc_tag_e tag;
+};
+
+static void* tracked_alloc(size_t size) {
+    alloc_header_t* header = (alloc_header_t*)malloc(sizeof(alloc_header_t) + size);
+    if (header == nullptr) {
+        return nullptr;
+    }
+    header->size = size;
+    header->tag = current_tag;
+    alloc_counts[header->tag].fetch_add(1, memory_order_relaxed);
+    int64_t live = live_bytes.fetch_add((int64_t)size, memory_order_relaxed) + (int64_t)size;
+    int64_t peak = peak_bytes.load(memory_order_relaxed);
+    while (live > peak && !peak_bytes.compare_exchange_weak(peak, live, memory_order_relaxed)) {}
+    return header + 1;
+}
+
+static void tracked_free(void* ptr) {
+    if (ptr == nullptr) {
+        return;
+    }
+    alloc_header_t* header = (alloc_header_t*)ptr - 1;
+    free_counts[header->tag].fetch_add(1, memory_order_relaxed);
+    live_bytes.fetch_sub((int64_t)header->size, memory_order_relaxed);
+    free(header);
+}
+
+void* operator new(size_t size) {
+    void* ptr = tracked_alloc(size);
+    if (ptr == nullptr) {
+        throw bad_alloc();
+    }
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    return tracked_alloc(size);
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept {
+    return tracked_alloc(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    tracked_free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    tracked_free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    tracked_free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    tracked_free(ptr);
+}
+
+void operator delete(void* ptr, const nothrow_t&) noexcept {
+    tracked_free(ptr);
+}
+
+void operator delete[](void* ptr, const nothrow_t&) noexcept {
+    tracked_free(ptr);
+}
+
+#endif
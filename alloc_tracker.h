@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Counts operator new/delete calls per subsystem. Opt-in: built with
+// -DTRACK_ALLOCS the global operators are replaced with counting ones,
+// otherwise nothing is hooked and every counter stays at zero.
+#ifdef TRACK_ALLOCS
+constexpr bool ALLOC_TRACKING = true;
+#else
+constexpr bool ALLOC_TRACKING = false;
+#endif
+
+// Subsystem an allocation is charged to, set per thread by alloc_scope_t.
+enum alloc_tag_e {
+    ALLOC_OTHER,
+    ALLOC_SIM,      // game_t::step: actions and their callbacks
+    ALLOC_GATHER,
+    ALLOC_SORT,
+    ALLOC_RENDER,   // floor cache and drawing
+    ALLOC_HUD,
+    ALLOC_STREAM,   // chunk loader thread
+    ALLOC_TAG_COUNT
+};
+
+extern const char* const ALLOC_TAG_NAMES[ALLOC_TAG_COUNT];
+
+// Charges allocations on this thread to tag until the scope ends.
+class alloc_scope_t {
+public:
+    explicit alloc_scope_t(alloc_tag_e tag);
+    alloc_scope_t(const alloc_scope_t&) = delete;
+    alloc_scope_t& operator=(const alloc_scope_t&) = delete;
+    ~alloc_scope_t();
+
+private:
+    alloc_tag_e prev;
+};
+
+struct alloc_totals_t {
+    uint64_t allocs[ALLOC_TAG_COUNT];
+    uint64_t frees[ALLOC_TAG_COUNT];
+    // Bytes currently allocated and the most ever at once, over all tags.
+    int64_t live_bytes;
+    int64_t peak_bytes;
+};
+
+// Counters since startup, from every thread.
+alloc_totals_t alloc_totals();
+
+// Allocations per frame, from the difference of the totals between calls
+// of end_frame().
+class alloc_frame_stats_t {
+public:
+    // The last frame's allocations, and the sum over all frames.
+    uint64_t frame[ALLOC_TAG_COUNT] = {0};
+    uint64_t frame_total = 0;
+    uint64_t total[ALLOC_TAG_COUNT] = {0};
+    uint64_t frames = 0;
+    // Frames that allocated nothing, and the most allocations in one frame
+    // after the first, which warms up buffers kept for later frames.
+    uint64_t clean_frames = 0;
+    uint64_t worst_frame = 0;
+    int64_t live_bytes = 0;
+    int64_t peak_bytes = 0;
+
+    alloc_frame_stats_t();
+
+    void end_frame();
+
+private:
+    uint64_t last[ALLOC_TAG_COUNT];
+};
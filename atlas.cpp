@@ -0,0 +1,171 @@
+#include <cstring>
+#include "atlas.h"
+
+using namespace std;
+
+atlas_t atlas;
+
+bool atlas_t::load(const char* path) {
+    texture = LoadTexture(path);
+    if (texture.width == 0) {
+        return false;
+    }
+
+    num_tiles_x = texture.width / SPRITE_WIDTH;
+    num_tiles_y = texture.height / SPRITE_HEIGHT;
+
+    frames.resize(num_tiles_x * num_tiles_y * 2);
+    frame_names.clear();
+    animations.clear();
+    for (int i = 0; i < num_tiles_x * num_tiles_y; i++) {
+        atlas_frame_t frame = (atlas_frame_t){
+            .src = (Rectangle){
+                .x = (float)((i % num_tiles_x) * SPRITE_WIDTH),
+                .y = (float)((i / num_tiles_x) * SPRITE_HEIGHT),
+                .width = SPRITE_WIDTH,
+                .height = SPRITE_HEIGHT
+            },
+            .offset = (Vector2){0, 0}
+        };
+        frames[i*2] = frame;
+        frame.src.width = -frame.src.width;
+        frames[i*2 + 1] = frame;
+    }
+
+    return true;
+}
+
+class meta_reader_t {
+private:
+    const unsigned char* data;
+    int size;
+    int cursor = 0;
+public:
+    bool ok = true;
+
+    meta_reader_t(const unsigned char* data, int size) : data(data), size(size) {}
+
+    void read(void* dst, int count) {
+        if (!ok || cursor + count > size) {
+            ok = false;
+            memset(dst, 0, count);
+            return;
+        }
+        memcpy(dst, data + cursor, count);
+        cursor += count;
+    }
+
+    template<typename T>
+    T read() {
+        T value;
+        read(&value, sizeof(T));
+        return value;
+    }
+
+    string read_string(int len) {
+        string str(len, '\0');
+        read(&str[0], len);
+        return str;
+    }
+};
+
+bool atlas_t::load_meta(const char* path) {
+    int size = 0;
+    unsigned char* data = LoadFileData(path, &size);
+    if (data == nullptr) {
+        return false;
+    }
+
+    meta_reader_t reader(data, size);
+    atlas_meta_header_t header = reader.read<atlas_meta_header_t>();
+    if (!reader.ok || header.magic != ATLAS_META_MAGIC || header.version != ATLAS_META_VERSION) {
+        TraceLog(LOG_ERROR, "%s is not a valid atlas metadata file.", path);
+        UnloadFileData(data);
+        return false;
+    }
+
+    string texture_path = string(GetDirectoryPath(path)) + "/" + reader.read_string(header.texture_name_len);
+
+    frames.resize(header.frame_count * 2);
+    frame_names.resize(header.frame_count);
+    for (int i = 0; i < header.frame_count; i++) {
+        frame_names[i] = reader.read_string(reader.read<uint8_t>());
+        float x = reader.read<uint16_t>();
+        float y = reader.read<uint16_t>();
+        float w = reader.read<uint16_t>();
+        float h = reader.read<uint16_t>();
+        float source_w = reader.read<uint16_t>();
+        reader.read<uint16_t>();
+        float pivot_x = reader.read<int16_t>();
+        float pivot_y = reader.read<int16_t>();
+
+        frames[i*2] = (atlas_frame_t){
+            .src = (Rectangle){x, y, w, h},
+            .offset = (Vector2){-pivot_x, -pivot_y}
+        };
+        // Mirrored around the untrimmed cell, so flipping keeps the frame in place.
+        frames[i*2 + 1] = (atlas_frame_t){
+            .src = (Rectangle){x, y, -w, h},
+            .offset = (Vector2){source_w + pivot_x - w, -pivot_y}
+        };
+    }
+
+    animations.resize(header.anim_count);
+    for (int i = 0; i < header.anim_count; i++) {
+        atlas_anim_t& anim = animations[i];
+        anim.name = reader.read_string(reader.read<uint8_t>());
+        anim.loop = reader.read<uint8_t>() != 0;
+        int length = reader.read<uint16_t>();
+        anim.frames.resize(length);
+        anim.durations.resize(length);
+        for (int j = 0; j < length; j++) {
+            anim.frames[j] = reader.read<uint16_t>();
+            anim.durations[j] = reader.read<uint16_t>() / 1000.0f;
+        }
+    }
+
+    UnloadFileData(data);
+    if (!reader.ok) {
+        TraceLog(LOG_ERROR, "Atlas metadata %s is truncated.", path);
+        frames.clear();
+        return false;
+    }
+
+    texture = LoadTexture(texture_path.c_str());
+    if (texture.width == 0) {
+        frames.clear();
+        return false;
+    }
+    num_tiles_x = num_tiles_y = 0;
+
+    return true;
+}
+
+void atlas_t::unload() {
+    if (texture.id != 0) {
+        UnloadTexture(texture);
+    }
+    texture = (Texture2D){0};
+    frames.clear();
+    frame_names.clear();
+    animations.clear();
+    num_tiles_x = num_tiles_y = 0;
+}
+
+int atlas_t::find_frame(const char* name) const {
+    for (size_t i = 0; i < frame_names.size(); i++) {
+        if (frame_names[i] == name) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+const atlas_anim_t* atlas_t::find_animation(const char* name) const {
+    for (size_t i = 0; i < animations.size(); i++) {
+        if (animations[i].name == name) {
+            return &animations[i];
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <raylib.h>
+
+constexpr int SPRITE_WIDTH = 64;
+constexpr int SPRITE_HEIGHT = 64;
+
+// Binary atlas metadata written by tools/atlas_packer, all fields little endian:
+//   header, texture file name (relative to the metadata file),
+//   frame_count x { u8 name_len, name, u16 x, y, w, h, u16 source_w, source_h, i16 pivot_x, pivot_y }
+//   anim_count  x { u8 name_len, name, u8 loop, u16 length, length x { u16 frame, u16 duration_ms } }
+// The pivot is the point of the trimmed frame that lands on the sprite's screen
+// position, i.e. where the top-left corner of the untrimmed source cell was.
+constexpr uint32_t ATLAS_META_MAGIC = 0x4c544149; // "IATL"
+constexpr uint16_t ATLAS_META_VERSION = 1;
+
+struct atlas_meta_header_t {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t frame_count;
+    uint16_t anim_count;
+    uint16_t texture_name_len;
+};
+
+struct atlas_frame_t {
+    Rectangle src;
+    Vector2 offset;
+};
+
+struct atlas_anim_t {
+    std::string name;
+    bool loop;
+    std::vector<uint16_t> frames;
+    std::vector<float> durations;
+};
+
+// Sprite sheet, either a grid of SPRITE_WIDTH x SPRITE_HEIGHT cells or a packed
+// texture described by atlas metadata. Source rectangles and draw offsets for
+// every frame are computed once on load, so drawing a sprite is a table lookup.
+class atlas_t {
+public:
+    Texture2D texture = {0};
+    int num_tiles_x = 0;
+    int num_tiles_y = 0;
+    // Two entries per frame: [idx*2] as stored, [idx*2 + 1] flipped horizontally.
+    std::vector<atlas_frame_t> frames;
+    std::vector<std::string> frame_names;
+    std::vector<atlas_anim_t> animations;
+
+    bool load(const char* path);
+
+    bool load_meta(const char* path);
+
+    void unload();
+
+    int find_frame(const char* name) const;
+
+    const atlas_anim_t* find_animation(const char* name) const;
+
+    const atlas_frame_t& frame(int atlas_idx, bool flip) const {
+        assert(atlas_idx >= 0 && atlas_idx*2 + 1 < (int)frames.size() && "Atlas index out of range");
+        return frames[atlas_idx*2 + (flip ? 1 : 0)];
+    }
+};
+
+extern atlas_t atlas;
@@ -1,11 +1,6 @@
+#include <cfloat>
 #include "baseclasses.h"
-
-extern Texture2D atlas_texture;
-extern int num_tiles_x;
-extern int num_tiles_y;
-
-constexpr int SPRITE_WIDTH = 64;
-constexpr int SPRITE_HEIGHT = 64;
+#include "atlas.h"
 
 Vector2 to_screen(Vector3 pos) {
     return (Vector2){
@@ -14,7 +9,80 @@ Vector2 to_screen(Vector3 pos) {
     };
 }
 
+static Rectangle rect_union(Rectangle a, Rectangle b) {
+    float x0 = fminf(a.x, b.x), y0 = fminf(a.y, b.y);
+    float x1 = fmaxf(a.x + a.width, b.x + b.width), y1 = fmaxf(a.y + a.height, b.y + b.height);
+    return (Rectangle){x0, y0, x1 - x0, y1 - y0};
+}
+
+void damage_t::add(Vector3 pos) {
+    // Frames are drawn within their SPRITE_WIDTH x SPRITE_HEIGHT cell.
+    Vector2 origin = to_screen(pos);
+    Rectangle cell = (Rectangle){origin.x, origin.y, SPRITE_WIDTH, SPRITE_HEIGHT};
+    // A sprite's last step mostly overlaps the cell it left.
+    if (count > 0 && (count == MAX_RECTS || CheckCollisionRecs(rects[count - 1], cell))) {
+        rects[count - 1] = rect_union(rects[count - 1], cell);
+    } else {
+        rects[count++] = cell;
+    }
+}
+
+void damage_t::add_everywhere() {
+    rects[0] = (Rectangle){-FLT_MAX / 4, -FLT_MAX / 4, FLT_MAX / 2, FLT_MAX / 2};
+    count = 1;
+}
+
+void active_set_t::add(sprite_t* sprite) {
+    assert(sprite->active_idx == -1 && "Sprite is already active");
+    sprite->active_idx = (int)members.size();
+    members.push_back(sprite);
+}
+
+void active_set_t::remove(sprite_t* sprite) {
+    assert(sprite->active_idx != -1 && members[sprite->active_idx] == sprite && "Sprite is not in this set");
+    members[sprite->active_idx] = members.back();
+    members[sprite->active_idx]->active_idx = sprite->active_idx;
+    members.pop_back();
+    sprite->active_idx = -1;
+}
+
+void active_set_t::update(float dt) {
+    size_t i = 0;
+    while (i < members.size()) {
+        sprite_t* sprite = members[i];
+        sprite->update(dt);
+        // Swap-removal pulls a not yet updated member into slot i.
+        if (sprite->active_idx == (int)i && sprite->is_idle()) {
+            remove(sprite);
+        } else {
+            i++;
+        }
+    }
+}
+
+size_t attachment_set_t::attach(sprite_t* parent, sprite_t* child, Vector3 offset, int atlas_offset, int layer) {
+    attachments.push_back((attachment_t){parent, child, offset, atlas_offset, layer, true});
+    return attachments.size() - 1;
+}
+
+void attachment_set_t::resolve(sprite_list_t& sprites) {
+    for (size_t i = 0; i < attachments.size(); i++) {
+        const attachment_t& att = attachments[i];
+        sprite_t* child = att.child;
+        child->pos = Vector3Add(att.parent->pos, att.offset);
+        child->footprint = att.parent->footprint;
+        child->atlas_idx = att.parent->atlas_idx + att.atlas_offset;
+        child->order_z = att.parent->order_z + att.layer;
+        if (att.is_visible) {
+            sprites.push_back(child);
+        }
+    }
+}
+
 sprite_t::~sprite_t() {
+    if (active_set != nullptr && active_idx != -1) {
+        active_set->remove(this);
+    }
     if (action != nullptr) {
         delete action;
     }
@@ -22,11 +90,13 @@ sprite_t::~sprite_t() {
 
 void sprite_t::set_action(void* new_action, bool forced = false) {
     assert(new_action != nullptr && "Nullptr provided, expected a valid pointer to action_t");
-    if (forced || (action != nullptr && action->is_finished())) {
+    if (forced || action == nullptr || action->is_finished()) {
         if (action != nullptr) {
             delete action;
         }
         action = (action_t*)new_action;
+        activate();
+        mark_dirty();
     }
 }
 
@@ -41,45 +111,108 @@ void sprite_t::stop_action(bool forced = true) {
     }
 }
 
-void sprite_t::update(float dt) {
-    if (action != nullptr) {
-        action->step((void*)this, dt);
+void sprite_t::activate() {
+    if (active_set != nullptr && active_idx == -1) {
+        active_set->add(this);
     }
 }
 
-void sprite_t::draw() {
-    Rectangle src = (Rectangle){
-        .x = (this->atlas_idx % num_tiles_x) * SPRITE_WIDTH,
-        .y = (this->atlas_idx / num_tiles_x) * SPRITE_HEIGHT,
-        .width = (this->flip ? -1 : 1) * SPRITE_WIDTH,
-        .height = SPRITE_HEIGHT
-    };
-    DrawTextureRec(atlas_texture, src, to_screen((Vector3){this->pos.x, this->pos.y, this->pos.z}), WHITE);
+bool sprite_t::is_idle() {
+    return action == nullptr || action->is_finished();
+}
+
+void sprite_t::step_action(float dt) {
+    if (action == nullptr) {
+        return;
+    }
+
+    Vector3 last_pos = pos;
+    int last_atlas_idx = atlas_idx;
+    action->step((void*)this, dt);
+    mark_changed(last_pos, last_atlas_idx);
+    if (action->is_finished()) {
+        mark_dirty();
+        // Detached first, the callback may already start the next action.
+        action_t* done = action;
+        action = nullptr;
+        if (done->on_finish != nullptr) {
+            done->on_finish((void*)this, done);
+        }
+        delete done;
+    }
 }
 
-animatable_t::~animatable_t() {
-    if (anim != nullptr) {
-        delete anim;
+void sprite_t::mark_dirty() {
+    if (damage != nullptr) {
+        damage->add(pos);
     }
 }
 
-void animatable_t::set_animation(void* new_anim, bool forced = false) {
-    assert(new_anim != nullptr && "Nullptr provided, expected a valid pointer to action_t");
-    if (forced || (anim != nullptr && anim->is_finished())) {
-        if (anim != nullptr) {
-            delete anim;
-        }
-        anim = (action_t*)new_anim;
+void sprite_t::mark_changed(Vector3 last_pos, int last_atlas_idx) {
+    if (damage == nullptr) {
+        return;
+    }
+    if (pos.x != last_pos.x || pos.y != last_pos.y || pos.z != last_pos.z) {
+        damage->add(last_pos);
+        damage->add(pos);
+    } else if (atlas_idx != last_atlas_idx) {
+        damage->add(pos);
+    }
+}
+
+void sprite_t::update(float dt) {
+    step_action(dt);
+}
+
+void sprite_t::draw() {
+    const atlas_frame_t& frame = atlas.frame(this->atlas_idx, this->flip);
+    DrawTextureRec(atlas.texture, frame.src, Vector2Add(to_screen((Vector3){this->pos.x, this->pos.y, this->pos.z}), frame.offset), WHITE);
+}
+
+void animatable_t::play_clip(const clip_t* clip, bool forced = false) {
+    assert(clip != nullptr && "Nullptr provided, expected a valid clip");
+    if (forced || !cursor.is_playing()) {
+        cursor.play(clip);
+        wake();
     }
 }
 
-void animatable_t::stop_animation(bool forced = true) {
-    if (anim == nullptr) {
+void animatable_t::stop_animation() {
+    cursor.clip = nullptr;
+}
+
+bool animatable_t::is_animating() {
+    return cursor.is_playing();
+}
+
+void animatable_t::step_animation(sprite_t* sprite, float dt) {
+    if (!cursor.is_playing()) {
         return;
     }
 
-    if (forced || anim->is_finished()) {
-        delete anim;
-        anim = nullptr;
+    int frame = cursor.advance(dt);
+    if (frame != sprite->atlas_idx) {
+        sprite->atlas_idx = frame;
+        sprite->mark_dirty();
     }
-}
\ No newline at end of file
+}
+// The pooled_t free lists the thread has put nodes on.
+struct thread_free_lists_t {
+    std::vector<void**> lists;
+
+    ~thread_free_lists_t() {
+        for (size_t i = 0; i < lists.size(); i++) {
+            while (*lists[i] != nullptr) {
+                void* node = *lists[i];
+                *lists[i] = *(void**)node;
+                ::operator delete(node);
+            }
+        }
+    }
+};
+
+static thread_local thread_free_lists_t thread_free_lists;
+
+void release_at_thread_exit(void** free_list) {
+    thread_free_lists.lists.push_back(free_list);
+}
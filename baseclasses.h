@@ -1,18 +1,121 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
 #include <raylib.h>
 #include <raymath.h>
+#include "clips.h"
+#include "frame_arena.h"
 
 Vector2 to_screen(Vector3 pos);
 
 class sprite_t;
 
+// Sprites with a running action or animation. set_action/set_animation add a
+// sprite, update() drops it again once everything it runs has finished, so
+// idle sprites cost nothing per frame.
+class active_set_t {
+public:
+    std::vector<sprite_t*> members;
+
+    void add(sprite_t* sprite);
+
+    void remove(sprite_t* sprite);
+
+    void update(float dt);
+};
+
+// Screen area that changed since it was last cleared, so frames that would
+// look the same can be skipped. Sprites report to it when they start or
+// finish an action, move or change frame.
+struct damage_t {
+    // Separate areas kept apart, so changes on both sides of the view do not
+    // add up to one covering it. Beyond that many the last one grows.
+    static constexpr int MAX_RECTS = 8;
+    Rectangle rects[MAX_RECTS];
+    int count = 0;
+
+    // Adds the cell a sprite at pos is drawn in.
+    void add(Vector3 pos);
+
+    // Damages all of the screen, e.g. once more of the level streamed in.
+    void add_everywhere();
+
+    bool intersects(Rectangle rect) const {
+        for (int i = 0; i < count; i++) {
+            if (CheckCollisionRecs(rects[i], rect)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void clear() {
+        count = 0;
+    }
+};
+
+class action_t;
+
+typedef void (*action_callback_t)(void* ent, action_t* action);
+
+// Actions are owned by the sprite running them. Once finished they are
+// detached, on_finish is called and the action is deleted, so a completed
+// action never gets stepped again.
 class action_t {
 public:
+    action_callback_t on_finish = nullptr;
+
+    virtual ~action_t() {}
     virtual bool is_finished() = 0;
     virtual void step(void* anim_ent, float dt) = 0;
-    virtual void finish(void* anim_ent) = 0;
+    // Rewinds to the start, used by repeat_t.
+    virtual void reset() {}
+};
+
+// Hands a thread's free list back to the heap when the thread exits, so
+// worker threads ending before the program don't leak their nodes.
+void release_at_thread_exit(void** free_list);
+
+// Recycles freed instances of T through a per-thread free list instead of
+// returning them to the heap. Subclasses of T of a different size fall back
+// to the global allocator.
+template<typename T>
+class pooled_t {
+public:
+    static void* operator new(size_t size) {
+        if (size == sizeof(T) && free_list != nullptr) {
+            free_node_t* node = free_list;
+            free_list = node->next;
+            return node;
+        }
+        return ::operator new(size);
+    }
+
+    static void operator delete(void* ptr, size_t size) {
+        if (size != sizeof(T)) {
+            ::operator delete(ptr);
+            return;
+        }
+        if (!is_registered) {
+            release_at_thread_exit((void**)&free_list);
+            is_registered = true;
+        }
+        free_node_t* node = (free_node_t*)ptr;
+        node->next = free_list;
+        free_list = node;
+    }
+
+private:
+    struct free_node_t {
+        free_node_t* next;
+    };
+
+    static inline thread_local free_node_t* free_list = nullptr;
+    static inline thread_local bool is_registered = false;
 };
 
 class sprite_t {
@@ -22,8 +125,16 @@ public:
     Vector3 pos;
     bool flip;
     int order_z;
+    // Size of the sprite's box for depth ordering: x and y in tiles, height in
+    // pixels upwards from pos. Floor tiles are flat.
+    Vector3 footprint = {1.0f, 1.0f, 0.0f};
+    // Set to have set_action register the sprite there, see active_set_t.
+    active_set_t* active_set = nullptr;
+    int active_idx = -1;
+    // Set to have the sprite report its changes there, see damage_t.
+    damage_t* damage = nullptr;
 
-    ~sprite_t();
+    virtual ~sprite_t();
 
     sprite_t()
     : pos((Vector3){.x = 0, .y = 0, .z = 0}), atlas_idx(0), flip(false), order_z(0) {}
@@ -38,18 +149,75 @@ public:
 
     void stop_action(bool forced);
 
+    void activate();
+
+    // Reports the sprite's cell as changed, for changes made from outside
+    // its action and clip, e.g. before putting it somewhere else.
+    void mark_dirty();
+
+    // Steps the action and reclaims it once it has finished.
+    void step_action(float dt);
+
+    virtual bool is_idle();
+
     virtual void update(float dt);
 
     virtual void draw();
+
+private:
+    // Reports where the sprite was and is if it moved or changed frame.
+    void mark_changed(Vector3 last_pos, int last_atlas_idx);
+};
+
+// Falling tiles and the like are deleted by the game once done, through
+// their own type or a sprite_t*.
+static_assert(std::has_virtual_destructor<sprite_t>::value, "sprite_t subclasses are deleted polymorphically");
+
+// Sprites to draw this frame, on the frame arena when the caller has one. A
+// list on the arena must not be kept past the arena's reset.
+typedef frame_vector_t<sprite_t*> sprite_list_t;
+
+// A sprite drawn as part of another one, e.g. a character's eyes. The child
+// follows the parent's position and frame and is layered above it.
+struct attachment_t {
+    sprite_t* parent;
+    sprite_t* child;
+    Vector3 offset;
+    // Added to the parent's atlas_idx and order_z.
+    int atlas_offset;
+    int layer;
+    bool is_visible;
 };
 
+// Attachments resolved together in one pass once the parents have moved,
+// instead of every composite entity building its parts while being drawn.
+class attachment_set_t {
+public:
+    std::vector<attachment_t> attachments;
+
+    // Returns the attachment's index. A parent that is attached itself must
+    // have been attached first, so it is resolved before its children.
+    size_t attach(sprite_t* parent, sprite_t* child, Vector3 offset, int atlas_offset = 0, int layer = 1);
+
+    // Places every child on its parent and appends the visible ones to sprites.
+    void resolve(sprite_list_t& sprites);
+};
+
+// Plays a keyframe clip on a sprite through a clip_cursor_t.
 class animatable_t {
 public:
-    action_t* anim = nullptr;
+    clip_cursor_t cursor;
+
+    void play_clip(const clip_t* clip, bool forced);
+
+    void stop_animation();
 
-    ~animatable_t();
+    bool is_animating();
 
-    void set_animation(void* new_anim, bool forced);
+    // Advances the clip and shows its current frame on the sprite.
+    void step_animation(sprite_t* sprite, float dt);
 
-    void stop_animation(bool forced);
+protected:
+    // Called when a new clip started, sprites forward this to activate().
+    virtual void wake() {}
 };
\ No newline at end of file
@@ -1 +1,3 @@
-g++ -Wall -I./include -o iso.exe main.cpp baseclasses.cpp ./lib/libraylib.a -lc -lm
\ No newline at end of file
+g++ -Wall -I./include -o iso.exe main.cpp baseclasses.cpp actions.cpp game.cpp replay.cpp atlas.cpp level.cpp chunks.cpp clips.cpp depth.cpp floor_cache.cpp hud.cpp planes.cpp frame_arena.cpp alloc_tracker.cpp perf_counters.cpp hitch.cpp redraw.cpp server.cpp env_batch.cpp ./lib/libraylib.a -lc -lm -pthread
+g++ -Wall -I./include -o atlas_packer.exe tools/atlas_packer.cpp ./lib/libraylib.a -lc -lm
+g++ -Wall -I./include -o make_level.exe tools/make_level.cpp level.cpp
\ No newline at end of file
@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "chunks.h"
+#include "alloc_tracker.h"
+
+using namespace std;
+
+static bool seek(FILE* file, uint64_t offset) {
+#ifdef _WIN32
+    return _fseeki64(file, (__int64)offset, SEEK_SET) == 0;
+#else
+    return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+chunk_streamer_t::~chunk_streamer_t() {
+    close();
+}
+
+bool chunk_streamer_t::open(const char* path) {
+    close();
+
+    file = fopen(path, "rb");
+    if (file == nullptr) {
+        fprintf(stderr, "Failed to open level %s\n", path);
+        return false;
+    }
+
+    level_header_t header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != LEVEL_MAGIC || header.version != LEVEL_VERSION || header.tile_size != sizeof(level_tile_t)) {
+        fprintf(stderr, "%s is not a valid level\n", path);
+        close();
+        return false;
+    }
+
+    entities.resize(header.entity_count);
+    if (!seek(file, header.entities_offset) || fread(entities.data(), sizeof(level_entity_t), entities.size(), file) != entities.size()) {
+        fprintf(stderr, "Level %s is truncated\n", path);
+        close();
+        return false;
+    }
+
+    width = header.width;
+    height = header.height;
+    tiles_offset = header.tiles_offset;
+
+    is_running = true;
+    loader = thread(&chunk_streamer_t::loader_main, this);
+    return true;
+}
+
+void chunk_streamer_t::close() {
+    if (loader.joinable()) {
+        {
+            lock_guard<mutex> lock(queue_mutex);
+            is_running = false;
+        }
+        wake.notify_all();
+        loader.join();
+    }
+
+    for (auto& it : chunks) {
+        delete it.second;
+    }
+    for (chunk_t* chunk : requests) {
+        delete chunk;
+    }
+    for (chunk_t* chunk : loaded) {
+        delete chunk;
+    }
+    for (chunk_t* chunk : free_chunks) {
+        delete chunk;
+    }
+    chunks.clear();
+    deltas.clear();
+    pending.clear();
+    requests.clear();
+    loaded.clear();
+    free_chunks.clear();
+    resident.clear();
+    published.clear();
+    lru.clear();
+    entities.clear();
+
+    if (file != nullptr) {
+        fclose(file);
+        file = nullptr;
+    }
+    width = height = 0;
+}
+
+chunk_t* chunk_streamer_t::find(int cx, int cy) {
+    auto it = chunks.find(key(cx, cy));
+    return it != chunks.end() ? it->second : nullptr;
+}
+
+chunk_t* chunk_streamer_t::alloc_chunk(int cx, int cy) {
+    chunk_t* chunk;
+    if (!free_chunks.empty()) {
+        chunk = free_chunks.back();
+        free_chunks.pop_back();
+    } else {
+        chunk = new chunk_t();
+    }
+    chunk->cx = cx;
+    chunk->cy = cy;
+    chunk->pins = 0;
+    chunk->modified.clear();
+    return chunk;
+}
+
+void chunk_streamer_t::make_resident(chunk_t* chunk) {
+    chunks[key(chunk->cx, chunk->cy)] = chunk;
+    chunk->resident_idx = resident.size();
+    resident.push_back(chunk);
+    published.push_back(chunk);
+    lru.push_front(chunk);
+    chunk->lru = lru.begin();
+}
+
+void chunk_streamer_t::evict(chunk_t* chunk) {
+    uint64_t k = key(chunk->cx, chunk->cy);
+    chunks.erase(k);
+
+    resident[chunk->resident_idx] = resident.back();
+    resident[chunk->resident_idx]->resident_idx = chunk->resident_idx;
+    resident.pop_back();
+    lru.erase(chunk->lru);
+
+    if (!chunk->modified.empty()) {
+        vector<chunk_delta_t>& changes = deltas[k];
+        changes.clear();
+        for (uint16_t idx : chunk->modified) {
+            changes.push_back((chunk_delta_t){idx, chunk->tiles[idx]});
+        }
+    }
+    free_chunks.push_back(chunk);
+}
+
+void chunk_streamer_t::focus(float x, float y) {
+    int fcx = (int)floorf(x) / CHUNK_SIZE;
+    int fcy = (int)floorf(y) / CHUNK_SIZE;
+    int max_cx = (int)((width - 1) / CHUNK_SIZE);
+    int max_cy = (int)((height - 1) / CHUNK_SIZE);
+
+    bool requested = false;
+    for (int cy = max(0, fcy - STREAM_RADIUS); cy <= min(max_cy, fcy + STREAM_RADIUS); cy++) {
+        for (int cx = max(0, fcx - STREAM_RADIUS); cx <= min(max_cx, fcx + STREAM_RADIUS); cx++) {
+            uint64_t k = key(cx, cy);
+            if (chunk_t* chunk = find(cx, cy)) {
+                lru.splice(lru.begin(), lru, chunk->lru);
+                continue;
+            }
+
+            if (pending.count(k) == 0) {
+                pending[k] = true;
+                chunk_t* chunk = alloc_chunk(cx, cy);
+                lock_guard<mutex> lock(queue_mutex);
+                requests.push_back(chunk);
+                requested = true;
+            }
+        }
+    }
+
+    if (requested) {
+        wake.notify_one();
+    }
+}
+
+void chunk_streamer_t::pump() {
+    vector<chunk_t*> ready;
+    {
+        lock_guard<mutex> lock(queue_mutex);
+        ready.swap(loaded);
+    }
+
+    for (chunk_t* chunk : ready) {
+        uint64_t k = key(chunk->cx, chunk->cy);
+        pending.erase(k);
+        auto it = deltas.find(k);
+        if (it != deltas.end()) {
+            for (const chunk_delta_t& delta : it->second) {
+                chunk->tiles[delta.idx] = delta.tile;
+                chunk->modified.push_back(delta.idx);
+            }
+            deltas.erase(it);
+        }
+        make_resident(chunk);
+    }
+
+    auto it = lru.end();
+    while (resident.size() > CHUNK_CACHE_SIZE && it != lru.begin()) {
+        --it;
+        chunk_t* chunk = *it;
+        if (chunk->pins > 0) {
+            continue;
+        }
+        it = next(it);
+        evict(chunk);
+    }
+}
+
+void chunk_streamer_t::flush() {
+    while (!pending.empty()) {
+        {
+            unique_lock<mutex> lock(queue_mutex);
+            done.wait(lock, [this] { return !loaded.empty(); });
+        }
+        pump();
+    }
+}
+
+void chunk_streamer_t::mark_dirty(int x, int y) {
+    if (chunk_t* chunk = find(x / CHUNK_SIZE, y / CHUNK_SIZE)) {
+        uint16_t idx = (uint16_t)((y % CHUNK_SIZE) * CHUNK_SIZE + x % CHUNK_SIZE);
+        if (std::find(chunk->modified.begin(), chunk->modified.end(), idx) == chunk->modified.end()) {
+            chunk->modified.push_back(idx);
+        }
+    }
+}
+
+void chunk_streamer_t::pin(int x, int y, int delta) {
+    if (chunk_t* chunk = find(x / CHUNK_SIZE, y / CHUNK_SIZE)) {
+        chunk->pins += delta;
+    }
+}
+
+const level_entity_t* chunk_streamer_t::find_entity(level_entity_type_e type) const {
+    for (size_t i = 0; i < entities.size(); i++) {
+        if (entities[i].type == type) {
+            return &entities[i];
+        }
+    }
+    return nullptr;
+}
+
+void chunk_streamer_t::load(chunk_t* chunk) {
+    memset(chunk->tiles, 0, sizeof(chunk->tiles));
+
+    int x0 = chunk->cx * CHUNK_SIZE;
+    int count = min(CHUNK_SIZE, (int)width - x0);
+    for (int row = 0; row < CHUNK_SIZE; row++) {
+        uint64_t y = (uint64_t)chunk->cy * CHUNK_SIZE + row;
+        if (y >= height) {
+            break;
+        }
+        uint64_t offset = tiles_offset + (y * width + x0) * sizeof(level_tile_t);
+        if (!seek(file, offset) || fread(&chunk->tiles[row * CHUNK_SIZE], sizeof(level_tile_t), count, file) != (size_t)count) {
+            fprintf(stderr, "Failed to read chunk %d, %d\n", chunk->cx, chunk->cy);
+            break;
+        }
+    }
+}
+
+void chunk_streamer_t::loader_main() {
+    alloc_scope_t scope(ALLOC_STREAM);
+    while (true) {
+        chunk_t* chunk;
+        {
+            unique_lock<mutex> lock(queue_mutex);
+            wake.wait(lock, [this] { return !is_running || !requests.empty(); });
+            if (!is_running) {
+                return;
+            }
+            chunk = requests.front();
+            requests.pop_front();
+        }
+
+        load(chunk);
+
+        {
+            lock_guard<mutex> lock(queue_mutex);
+            loaded.push_back(chunk);
+        }
+        done.notify_all();
+    }
+}
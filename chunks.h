@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "level.h"
+
+constexpr int CHUNK_SIZE = 32;
+// Chunks within this many chunks of a focus point are kept resident.
+constexpr int STREAM_RADIUS = 2;
+// Resident chunks beyond this are evicted, least recently focused first.
+constexpr size_t CHUNK_CACHE_SIZE = 64;
+
+// A cell of an evicted chunk that differs from the level file.
+struct chunk_delta_t {
+    uint16_t idx;
+    level_tile_t tile;
+};
+
+struct chunk_t {
+    int cx, cy;
+    int pins = 0;
+    // Cells changed by the game, indices into tiles.
+    std::vector<uint16_t> modified;
+    size_t resident_idx = 0;
+    std::list<chunk_t*>::iterator lru;
+    level_tile_t tiles[CHUNK_SIZE*CHUNK_SIZE];
+};
+
+// Pages CHUNK_SIZE x CHUNK_SIZE blocks of a level file in and out around focus
+// points. Reads happen on a background thread; finished chunks are published
+// to the game by pump() on the calling thread, so everything but the file
+// access is single threaded. Evicted chunks only keep the cells the game
+// changed, which are put back when the chunk is loaded again, so memory stays
+// at CHUNK_CACHE_SIZE chunks plus a few bytes per changed cell.
+class chunk_streamer_t {
+public:
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<level_entity_t> entities;
+    std::vector<chunk_t*> resident;
+    // Chunks made resident since the owner last cleared this, for mirroring
+    // their tiles into state kept outside the chunks.
+    std::vector<chunk_t*> published;
+
+    chunk_streamer_t() {}
+    chunk_streamer_t(const chunk_streamer_t&) = delete;
+    chunk_streamer_t& operator=(const chunk_streamer_t&) = delete;
+    ~chunk_streamer_t();
+
+    bool open(const char* path);
+
+    void close();
+
+    // Requests every chunk within STREAM_RADIUS of the tile position and marks
+    // the resident ones as recently used.
+    void focus(float x, float y);
+
+    // Publishes chunks the loader finished and evicts down to CHUNK_CACHE_SIZE.
+    void pump();
+
+    // Blocks until every requested chunk is resident, used on startup.
+    void flush();
+
+    chunk_t* find(int cx, int cy);
+
+    level_tile_t* tile_at(int x, int y) {
+        chunk_t* chunk = find(x / CHUNK_SIZE, y / CHUNK_SIZE);
+        if (chunk == nullptr) {
+            return nullptr;
+        }
+        return &chunk->tiles[(y % CHUNK_SIZE) * CHUNK_SIZE + x % CHUNK_SIZE];
+    }
+
+    // Keeps the cell's state across evicting its chunk.
+    void mark_dirty(int x, int y);
+
+    // Pinned chunks are never evicted, e.g. while one of their tiles is animating.
+    void pin(int x, int y, int delta);
+
+    const level_entity_t* find_entity(level_entity_type_e type) const;
+
+private:
+    FILE* file = nullptr;
+    uint64_t tiles_offset = 0;
+
+    std::unordered_map<uint64_t, chunk_t*> chunks;
+    std::unordered_map<uint64_t, std::vector<chunk_delta_t>> deltas;
+    std::unordered_map<uint64_t, bool> pending;
+    std::list<chunk_t*> lru;
+    std::vector<chunk_t*> free_chunks;
+
+    std::thread loader;
+    std::mutex queue_mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::deque<chunk_t*> requests;
+    std::vector<chunk_t*> loaded;
+    bool is_running = false;
+
+    static uint64_t key(int cx, int cy) {
+        return ((uint64_t)(uint32_t)cy << 32) | (uint32_t)cx;
+    }
+
+    chunk_t* alloc_chunk(int cx, int cy);
+
+    void make_resident(chunk_t* chunk);
+
+    void evict(chunk_t* chunk);
+
+    void load(chunk_t* chunk);
+
+    void loader_main();
+};
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "clips.h"
+#include "atlas.h"
+
+using namespace std;
+
+// Eight jump frames over 1.5s, landing on the ninth.
+static const uint16_t PLAYER_JUMP_FRAMES[] = {2, 3, 4, 5, 6, 7, 8, 9, 10};
+static const float JUMP_ENDS[] = {0.1875f, 0.375f, 0.5625f, 0.75f, 0.9375f, 1.125f, 1.3125f, 1.5f, 1.5f};
+
+const clip_t CLIP_PLAYER_JUMP = {"player_jump", PLAYER_JUMP_FRAMES, JUMP_ENDS, 9, CLIP_ONCE, 1.5f};
+
+clip_library_t clip_library;
+
+int clip_cursor_t::advance(float dt) {
+    time += dt;
+    if (clip->loop == CLIP_LOOP && time >= clip->duration && clip->duration > 0.0f) {
+        time = fmodf(time, clip->duration);
+        key = 0;
+    }
+
+    while (key + 1 < clip->length && time >= clip->ends[key]) {
+        key++;
+    }
+    return clip->frames[key];
+}
+
+clip_library_t::clip_library_t() {
+    clips.push_back(&CLIP_PLAYER_JUMP);
+}
+
+const clip_t* clip_library_t::find(const char* name) const {
+    for (size_t i = 0; i < clips.size(); i++) {
+        if (strcmp(clips[i]->name, name) == 0) {
+            return clips[i];
+        }
+    }
+    return nullptr;
+}
+
+void clip_library_t::add_atlas_clips(const atlas_t& atlas) {
+    for (const atlas_anim_t& anim : atlas.animations) {
+        if (anim.frames.empty()) {
+            continue;
+        }
+
+        owned.emplace_back();
+        storage_t& storage = owned.back();
+        storage.name = anim.name;
+        storage.frames = anim.frames;
+        float end = 0.0f;
+        for (float duration : anim.durations) {
+            end += duration;
+            storage.ends.push_back(end);
+        }
+        storage.clip = (clip_t){
+            .name = storage.name.c_str(),
+            .frames = storage.frames.data(),
+            .ends = storage.ends.data(),
+            .length = (uint16_t)storage.frames.size(),
+            .loop = anim.loop ? CLIP_LOOP : CLIP_ONCE,
+            .duration = end
+        };
+
+        // The atlas' timing replaces a built-in clip of the same name.
+        auto same_name = [&storage](const clip_t* clip) { return storage.name == clip->name; };
+        auto it = find_if(clips.begin(), clips.end(), same_name);
+        if (it != clips.end()) {
+            *it = &storage.clip;
+        } else {
+            clips.push_back(&storage.clip);
+        }
+    }
+}
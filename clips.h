@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+class atlas_t;
+
+enum clip_loop_e : uint8_t {
+    CLIP_ONCE, CLIP_LOOP
+};
+
+// Immutable keyframe data, shared by every entity playing the clip.
+struct clip_t {
+    const char* name;
+    const uint16_t* frames;
+    // Cumulative end time of each key, the last one equals duration.
+    const float* ends;
+    uint16_t length;
+    clip_loop_e loop;
+    float duration;
+};
+
+// The only per-entity animation state: which clip and how far into it.
+// A clip played once holds its last frame when it ends.
+struct clip_cursor_t {
+    const clip_t* clip = nullptr;
+    float time = 0.0f;
+    uint16_t key = 0;
+
+    void play(const clip_t* new_clip) {
+        clip = new_clip;
+        time = 0.0f;
+        key = 0;
+    }
+
+    bool is_playing() const {
+        return clip != nullptr && (clip->loop == CLIP_LOOP || time < clip->duration);
+    }
+
+    int frame() const {
+        return clip->frames[key];
+    }
+
+    // Moves the cursor forward and returns the atlas index to show.
+    int advance(float dt);
+};
+
+extern const clip_t CLIP_PLAYER_JUMP;
+
+// Named clips: the built-in ones above, replaced or joined by any added
+// from atlas metadata.
+class clip_library_t {
+public:
+    std::vector<const clip_t*> clips;
+
+    clip_library_t();
+
+    const clip_t* find(const char* name) const;
+
+    // Adds the atlas' animation sequences, replacing built-in clips of the same name.
+    void add_atlas_clips(const atlas_t& atlas);
+
+private:
+    struct storage_t {
+        std::string name;
+        std::vector<uint16_t> frames;
+        std::vector<float> ends;
+        clip_t clip;
+    };
+    std::deque<storage_t> owned;
+};
+
+extern clip_library_t clip_library;
@@ -0,0 +1,368 @@
+#include <algorithm>
+#include <cmath>
+#include <raylib.h>
+#include <rlgl.h>
+#include "depth.h"
+#include "atlas.h"
+
+using namespace std;
+
+float nearness(sprite_t* sprite) {
+    return sprite->pos.x + sprite->pos.y - sprite->pos.z + sprite->order_z;
+}
+
+depth_box_t depth_box(const sprite_t* sprite) {
+    return (depth_box_t){
+        .min_x = sprite->pos.x, .max_x = sprite->pos.x + sprite->footprint.x,
+        .min_y = sprite->pos.y, .max_y = sprite->pos.y + sprite->footprint.y,
+        .min_h = -sprite->pos.z, .max_h = -sprite->pos.z + sprite->footprint.z
+    };
+}
+
+// a lies entirely beyond b along one axis. Two flat spans at the same spot are
+// beyond each other, which decides nothing.
+static int separation(float a_min, float a_max, float b_min, float b_max) {
+    bool a_beyond = a_min >= b_max;
+    bool b_beyond = b_min >= a_max;
+    if (a_beyond == b_beyond) {
+        return 0;
+    }
+    return a_beyond ? 1 : -1;
+}
+
+bool is_in_front(const depth_box_t& a, const depth_box_t& b, sprite_t* sa, sprite_t* sb) {
+    int side = separation(a.min_h, a.max_h, b.min_h, b.max_h);
+    if (side == 0) {
+        side = separation(a.min_x, a.max_x, b.min_x, b.max_x);
+    }
+    if (side == 0) {
+        side = separation(a.min_y, a.max_y, b.min_y, b.max_y);
+    }
+    if (side != 0) {
+        return side > 0;
+    }
+    return nearness(sa) > nearness(sb);
+}
+
+Rectangle screen_rect(const sprite_t* sprite) {
+    Vector2 origin = to_screen(sprite->pos);
+    if (sprite->atlas_idx*2 + 1 < (int)atlas.frames.size()) {
+        const atlas_frame_t& frame = atlas.frame(sprite->atlas_idx, sprite->flip);
+        return (Rectangle){origin.x + frame.offset.x, origin.y + frame.offset.y, fabsf(frame.src.width), frame.src.height};
+    }
+    return (Rectangle){origin.x, origin.y, SPRITE_WIDTH, SPRITE_HEIGHT};
+}
+
+static int cell_of(float v) {
+    float f = v * (1.0f / depth_sorter_t::CELL_SIZE);
+    int i = (int)f;
+    return i - (f < i);
+}
+
+static uint32_t cell_hash(int cx, int cy) {
+    return (uint32_t)cx * 73856093u ^ (uint32_t)cy * 19349663u;
+}
+
+template<typename F>
+static void for_each_cell(const Rectangle& r, F f) {
+    int x0 = cell_of(r.x), x1 = cell_of(r.x + r.width);
+    int y0 = cell_of(r.y), y1 = cell_of(r.y + r.height);
+    for (int cy = y0; cy <= y1; cy++) {
+        for (int cx = x0; cx <= x1; cx++) {
+            f(cx, cy);
+        }
+    }
+}
+
+void depth_sorter_t::sort(sprite_list_t& sprites, frame_arena_t* arena) {
+    const uint32_t count = (uint32_t)sprites.size();
+    pair_count = 0;
+    if (count < 2) {
+        return;
+    }
+
+    use_allocator(rects, frame_allocator_t<Rectangle>(arena));
+    use_allocator(boxes, frame_allocator_t<depth_box_t>(arena));
+    use_allocator(movers, frame_allocator_t<uint32_t>(arena));
+    use_allocator(bucket_start, frame_allocator_t<uint32_t>(arena));
+    use_allocator(entries, frame_allocator_t<cell_entry_t>(arena));
+    use_allocator(edge_from, frame_allocator_t<uint32_t>(arena));
+    use_allocator(edge_to, frame_allocator_t<uint32_t>(arena));
+    use_allocator(behind_start, frame_allocator_t<uint32_t>(arena));
+    use_allocator(behind, frame_allocator_t<uint32_t>(arena));
+    use_allocator(state, frame_allocator_t<uint8_t>(arena));
+    use_allocator(stack, frame_allocator_t<uint32_t>(arena));
+    use_allocator(sorted, frame_allocator_t<sprite_t*>(arena));
+    // Growing on the arena would leave each outgrown buffer behind.
+    rects.reserve(count);
+    boxes.reserve(count);
+    movers.reserve(count);
+    sorted.reserve(count);
+
+    // Only movers are binned. Everything lying flat on the floor plane is
+    // coplanar with everything else there and needs no order among itself,
+    // which leaves the resting tiles, the bulk of a frame, out of the grid.
+    rects.clear();
+    boxes.clear();
+    movers.clear();
+    size_t entry_count = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        rects.push_back(screen_rect(sprites[i]));
+        boxes.push_back(depth_box(sprites[i]));
+        if (boxes[i].min_h != 0.0f || boxes[i].max_h != 0.0f) {
+            movers.push_back(i);
+            entry_count += (size_t)(cell_of(rects[i].x + rects[i].width) - cell_of(rects[i].x) + 1)
+                * (cell_of(rects[i].y + rects[i].height) - cell_of(rects[i].y) + 1);
+        }
+    }
+
+    // Cells are hashed into a power of two number of buckets, so movers far
+    // apart (a tile falling at the other end of the map) do not blow up the
+    // grid. Four times as many buckets as entries keep most floor lookups
+    // empty. Counting first keeps the buckets in one flat array.
+    uint32_t bucket_count = 1;
+    while (bucket_count < 4 * entry_count) {
+        bucket_count <<= 1;
+    }
+    const uint32_t mask = bucket_count - 1;
+
+    bucket_start.assign(bucket_count + 1, 0);
+    for (uint32_t i : movers) {
+        for_each_cell(rects[i], [&](int cx, int cy) {
+            bucket_start[(cell_hash(cx, cy) & mask) + 1]++;
+        });
+    }
+    for (uint32_t b = 1; b <= bucket_count; b++) {
+        bucket_start[b] += bucket_start[b - 1];
+    }
+    entries.resize(entry_count);
+    // Used per bucket here and per sprite later on.
+    stack.reserve(max((size_t)bucket_count, (size_t)count));
+    stack.assign(bucket_start.begin(), bucket_start.end() - 1);
+    for (uint32_t i : movers) {
+        for_each_cell(rects[i], [&](int cx, int cy) {
+            entries[stack[cell_hash(cx, cy) & mask]++] = (cell_entry_t){.cx = cx, .cy = cy, .item = i};
+        });
+    }
+
+    // Each candidate pair below adds an edge at most: two movers sharing a
+    // bucket, or a floor sprite and a mover in the bucket of a cell it
+    // touches. There can be more edges than sprites, so the edges are
+    // reserved for that bound rather than grown on the arena.
+    size_t edge_bound = 0;
+    for (uint32_t b = 0; b < bucket_count; b++) {
+        size_t n = bucket_start[b + 1] - bucket_start[b];
+        edge_bound += n > 1 ? n * (n - 1) / 2 : 0;
+    }
+    if (!movers.empty()) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (boxes[i].min_h == 0.0f && boxes[i].max_h == 0.0f) {
+                for_each_cell(rects[i], [&](int cx, int cy) {
+                    uint32_t b = cell_hash(cx, cy) & mask;
+                    edge_bound += bucket_start[b + 1] - bucket_start[b];
+                });
+            }
+        }
+    }
+    edge_from.reserve(edge_bound);
+    edge_to.reserve(edge_bound);
+
+    // Compares a pair if their rectangles overlap. A pair shares several cells
+    // at most, it is only handled in the cell holding the overlap's top-left.
+    edge_from.clear();
+    edge_to.clear();
+    auto compare = [&](uint32_t i, uint32_t j, int cx, int cy) {
+        const Rectangle& a = rects[i];
+        const Rectangle& b = rects[j];
+        float ox = fmaxf(a.x, b.x);
+        float oy = fmaxf(a.y, b.y);
+        if (ox >= fminf(a.x + a.width, b.x + b.width) || oy >= fminf(a.y + a.height, b.y + b.height)) {
+            return;
+        }
+        if (cell_of(ox) != cx || cell_of(oy) != cy) {
+            return;
+        }
+
+        pair_count++;
+        if (is_in_front(boxes[i], boxes[j], sprites[i], sprites[j])) {
+            edge_from.push_back(i);
+            edge_to.push_back(j);
+        } else {
+            edge_from.push_back(j);
+            edge_to.push_back(i);
+        }
+    };
+
+    // Movers against each other.
+    for (uint32_t b = 0; b < bucket_count; b++) {
+        for (uint32_t p = bucket_start[b]; p < bucket_start[b + 1]; p++) {
+            for (uint32_t q = p + 1; q < bucket_start[b + 1]; q++) {
+                if (entries[q].cx == entries[p].cx && entries[q].cy == entries[p].cy) {
+                    compare(entries[p].item, entries[q].item, entries[p].cx, entries[p].cy);
+                }
+            }
+        }
+    }
+
+    // Floor sprites against the movers in the cells they touch.
+    if (!movers.empty()) {
+        for (uint32_t i = 0; i < count; i++) {
+            if (boxes[i].min_h != 0.0f || boxes[i].max_h != 0.0f) {
+                continue;
+            }
+            for_each_cell(rects[i], [&](int cx, int cy) {
+                uint32_t b = cell_hash(cx, cy) & mask;
+                for (uint32_t p = bucket_start[b]; p < bucket_start[b + 1]; p++) {
+                    if (entries[p].cx == cx && entries[p].cy == cy) {
+                        compare(i, entries[p].item, cx, cy);
+                    }
+                }
+            });
+        }
+    }
+
+    // behind[behind_start[i] ..] lists the sprites drawn before sprite i.
+    behind_start.assign(count + 1, 0);
+    for (size_t e = 0; e < edge_from.size(); e++) {
+        behind_start[edge_from[e] + 1]++;
+    }
+    for (uint32_t i = 1; i <= count; i++) {
+        behind_start[i] += behind_start[i - 1];
+    }
+    behind.resize(edge_from.size());
+    stack.assign(behind_start.begin(), behind_start.end() - 1);
+    for (size_t e = 0; e < edge_from.size(); e++) {
+        behind[stack[edge_from[e]]++] = edge_to[e];
+    }
+
+    // Depth-first topological order: everything behind a sprite is emitted
+    // before it. Intersecting cycles are cut where the walk re-enters them.
+    enum { UNVISITED, VISITING, DONE };
+    state.assign(count, UNVISITED);
+    sorted.clear();
+    for (uint32_t root = 0; root < count; root++) {
+        if (state[root] != UNVISITED) {
+            continue;
+        }
+        stack.clear();
+        stack.push_back(root);
+        state[root] = VISITING;
+        while (!stack.empty()) {
+            uint32_t i = stack.back();
+            bool descended = false;
+            for (uint32_t e = behind_start[i]; e < behind_start[i + 1]; e++) {
+                uint32_t j = behind[e];
+                if (state[j] == UNVISITED) {
+                    state[j] = VISITING;
+                    stack.push_back(j);
+                    descended = true;
+                    break;
+                }
+            }
+            if (!descended) {
+                state[i] = DONE;
+                sorted.push_back(sprites[i]);
+                stack.pop_back();
+            }
+        }
+    }
+
+    sprites.swap(sorted);
+}
+
+void sort_sprites(sprite_list_t& sprites, frame_arena_t* arena) {
+    static thread_local depth_sorter_t sorter;
+    sorter.sort(sprites, arena);
+}
+
+float depth_key(sprite_t* sprite) {
+    return nearness(sprite) + sprite->footprint.z / SPRITE_HEIGHT;
+}
+
+// raylib's default fragment shader plus a discard, so transparent texels do
+// not write depth and hide what is behind them.
+static const char* ALPHA_TEST_FS =
+    "#version 330\n"
+    "in vec2 fragTexCoord;\n"
+    "in vec4 fragColor;\n"
+    "uniform sampler2D texture0;\n"
+    "uniform vec4 colDiffuse;\n"
+    "out vec4 finalColor;\n"
+    "void main() {\n"
+    "    vec4 texel = texture(texture0, fragTexCoord) * colDiffuse * fragColor;\n"
+    "    if (texel.a < 0.5) discard;\n"
+    "    finalColor = texel;\n"
+    "}\n";
+
+bool depth_renderer_t::load() {
+    alpha_test = LoadShaderFromMemory(nullptr, ALPHA_TEST_FS);
+    if (!IsShaderValid(alpha_test) || alpha_test.id == rlGetShaderIdDefault()) {
+        TraceLog(LOG_ERROR, "Failed to compile the alpha test shader.");
+        alpha_test = Shader{};
+        return false;
+    }
+    return true;
+}
+
+void depth_renderer_t::unload() {
+    if (alpha_test.id != 0) {
+        UnloadShader(alpha_test);
+        alpha_test = Shader{};
+    }
+}
+
+void depth_renderer_t::draw(const sprite_list_t& sprites) {
+    if (sprites.empty()) {
+        return;
+    }
+
+    // The 2D projection keeps z in [-1, 0] with values closer to 0 in front.
+    // Keys are rescaled into that range per frame.
+    float lo = INFINITY, hi = -INFINITY;
+    for (size_t i = 0; i < sprites.size(); i++) {
+        float key = depth_key(sprites[i]);
+        lo = fminf(lo, key);
+        hi = fmaxf(hi, key);
+    }
+    const float scale = hi > lo ? 0.998f / (hi - lo) : 0.0f;
+
+    const float tex_w = (float)atlas.texture.width;
+    const float tex_h = (float)atlas.texture.height;
+
+    BeginShaderMode(alpha_test);
+    rlEnableDepthTest();
+    rlSetTexture(atlas.texture.id);
+    for (size_t i = 0; i < sprites.size(); i++) {
+        sprite_t* sprite = sprites[i];
+        const atlas_frame_t& frame = atlas.frame(sprite->atlas_idx, sprite->flip);
+        Vector2 origin = Vector2Add(to_screen(sprite->pos), frame.offset);
+        float z = -0.999f + (depth_key(sprite) - lo) * scale;
+
+        // Same quad as DrawTextureRec, a negative source width mirrors it.
+        float w = fabsf(frame.src.width), h = frame.src.height;
+        float u0 = frame.src.x / tex_w, u1 = (frame.src.x + w) / tex_w;
+        float v0 = frame.src.y / tex_h, v1 = (frame.src.y + h) / tex_h;
+        if (frame.src.width < 0) {
+            swap(u0, u1);
+        }
+
+        rlCheckRenderBatchLimit(4);
+        rlBegin(RL_QUADS);
+            rlColor4ub(255, 255, 255, 255);
+            rlNormal3f(0.0f, 0.0f, 1.0f);
+            rlTexCoord2f(u0, v0);
+            rlVertex3f(origin.x, origin.y, z);
+            rlTexCoord2f(u0, v1);
+            rlVertex3f(origin.x, origin.y + h, z);
+            rlTexCoord2f(u1, v1);
+            rlVertex3f(origin.x + w, origin.y + h, z);
+            rlTexCoord2f(u1, v0);
+            rlVertex3f(origin.x + w, origin.y, z);
+        rlEnd();
+    }
+    rlSetTexture(0);
+    // Flushed while the depth test is still on.
+    rlDrawRenderBatchActive();
+    rlDisableDepthTest();
+    EndShaderMode();
+}
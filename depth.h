@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "baseclasses.h"
+
+// World-space box of a sprite: its footprint on the map plus its height,
+// with h = -z growing upwards in screen pixels.
+struct depth_box_t {
+    float min_x, max_x;
+    float min_y, max_y;
+    float min_h, max_h;
+};
+
+depth_box_t depth_box(const sprite_t* sprite);
+
+// Bounds of the sprite's atlas frame in world screen coordinates.
+Rectangle screen_rect(const sprite_t* sprite);
+
+// Draw order key along the view direction, order_z breaks ties between
+// sprites sharing a spot.
+float nearness(sprite_t* sprite);
+
+// True when a has to be drawn after b. Boxes separated along height decide
+// first, then along x and y. Boxes that intersect fall back to nearness.
+bool is_in_front(const depth_box_t& a, const depth_box_t& b, sprite_t* sa, sprite_t* sb);
+
+// Isometric draw ordering by footprints. Sprites are binned into a coarse
+// hashed screen-space grid, only pairs whose screen rectangles overlap are
+// compared, and the resulting "drawn after" graph is ordered topologically.
+// Sprites that never overlap keep their gather order. Scratch buffers live
+// across frames, so a sort does not allocate once they have grown. Given a
+// frame arena they are taken from it instead and dropped with the frame.
+class depth_sorter_t {
+public:
+    static constexpr int CELL_SIZE = 64;
+
+    // Pairs compared by the last sort, for profiling.
+    size_t pair_count = 0;
+
+    void sort(sprite_list_t& sprites, frame_arena_t* arena = nullptr);
+
+private:
+    frame_vector_t<Rectangle> rects;
+    frame_vector_t<depth_box_t> boxes;
+    frame_vector_t<uint32_t> movers;
+    struct cell_entry_t {
+        int cx, cy;
+        uint32_t item;
+    };
+
+    frame_vector_t<uint32_t> bucket_start;
+    frame_vector_t<cell_entry_t> entries;
+    frame_vector_t<uint32_t> edge_from;
+    frame_vector_t<uint32_t> edge_to;
+    frame_vector_t<uint32_t> behind_start;
+    frame_vector_t<uint32_t> behind;
+    frame_vector_t<uint8_t> state;
+    frame_vector_t<uint32_t> stack;
+    sprite_list_t sorted;
+};
+
+// Orders sprites back to front with a per-thread depth_sorter_t.
+void sort_sprites(sprite_list_t& sprites, frame_arena_t* arena = nullptr);
+
+// Depth written for a sprite by depth_renderer_t: its nearness, lifted by its
+// height so a sprite standing on a tile wins over the tile. Unlike the
+// footprint sort this is one value per quad, so it is an approximation.
+float depth_key(sprite_t* sprite);
+
+// Draw order without sorting. Every sprite becomes a quad at its depth_key
+// with the depth test on and transparent texels discarded by an alpha test
+// shader, so sprites can be submitted in any order.
+class depth_renderer_t {
+public:
+    // Needs the window, the shader is compiled on load.
+    bool load();
+
+    void unload();
+
+    bool is_loaded() const {
+        return alpha_test.id != 0;
+    }
+
+    // Draws inside the current 2D mode with the atlas texture.
+    void draw(const sprite_list_t& sprites);
+
+private:
+    Shader alpha_test = {};
+};
@@ -0,0 +1,232 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include "env_batch.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ENV_SSE2
+#endif
+
+using namespace std;
+
+// Environments observe() writes at a time.
+static const size_t ENV_OBS_BLOCK = 64;
+
+env_batch_t::env_batch_t(size_t count, uint32_t seed)
+: count(count), rng_state(count), player_x(count), player_y(count), move_ticks(count), move_dir(count),
+  tile_age(count * ENV_TILES), live_tile(count), trap_x(count), trap_y(count), trap_ticks(count),
+  done(count), episode_ticks(count) {
+    for (size_t e = 0; e < count; e++) {
+        uint32_t env_seed = seed + (uint32_t)e;
+        rng_state[e] = env_seed != 0 ? env_seed : 1;
+        reset(e);
+    }
+}
+
+void env_batch_t::reset(size_t env) {
+    player_x[env] = 0;
+    player_y[env] = 0;
+    move_ticks[env] = 0;
+    move_dir[env] = MOVE_SOUTH;
+    for (int t = 0; t < ENV_TILES; t++) {
+        tile_age[t * count + env] = 0;
+    }
+    live_tile[env] = -1;
+    trap_x[env] = 0;
+    trap_y[env] = 0;
+    trap_ticks[env] = 0;
+    done[env] = 0;
+    episode_ticks[env] = 0;
+}
+
+int env_batch_t::random(size_t env) {
+    uint32_t state = rng_state[env];
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    rng_state[env] = state;
+    return (int)(state >> 1);
+}
+
+const uint8_t* env_batch_t::step(const int8_t* actions) {
+    for (size_t e = 0; e < count; e++) {
+        if (done[e]) {
+            reset(e);
+        }
+    }
+
+    // Hops start on input while standing and land when their last tick runs out.
+    for (size_t e = 0; e < count; e++) {
+        bool is_starting = actions[e] != INPUT_NONE && move_ticks[e] == 0;
+        move_dir[e] = is_starting ? (uint8_t)actions[e] : move_dir[e];
+        move_ticks[e] = is_starting ? (uint8_t)ENV_MOVE_TICKS : move_ticks[e];
+        int is_landing = move_ticks[e] == 1;
+        move_ticks[e] -= move_ticks[e] > 0;
+        int dir = move_dir[e];
+        player_x[e] += is_landing * ((dir == MOVE_SOUTH) - (dir == MOVE_NORTH));
+        player_y[e] += is_landing * ((dir == MOVE_WEST) - (dir == MOVE_EAST));
+    }
+
+    age_tiles();
+
+    // The rolls, only some environments draw any on a given tick.
+    for (size_t e = 0; e < count; e++) {
+        if (live_tile[e] != -1 && tile_age[live_tile[e] * count + e] > ENV_FALL_TICKS) {
+            live_tile[e] = -1;
+        }
+        if (live_tile[e] == -1) {
+            int t = random(e) % ENV_TILES;
+            if (tile_age[t * count + e] == 0) {
+                tile_age[t * count + e] = 1;
+                live_tile[e] = (int8_t)t;
+            }
+        }
+
+        if (trap_ticks[e] == 0) {
+            trap_x[e] = (int8_t)(random(e) % MAP_WIDTH);
+            trap_y[e] = (int8_t)(random(e) % MAP_HEIGHT);
+            trap_ticks[e] = ENV_TRAP_TICKS;
+            // A hopping player is only hit before it leaves its tile.
+            bool is_on_tile = move_ticks[e] == 0 || ENV_MOVE_TICKS - move_ticks[e] <= ENV_MOVE_DELAY_TICKS;
+            done[e] |= is_on_tile && trap_x[e] == player_x[e] && trap_y[e] == player_y[e];
+        }
+        trap_ticks[e]--;
+    }
+
+    // A standing player falls off the map or through a tile that gave way.
+    for (size_t e = 0; e < count; e++) {
+        int x = player_x[e], y = player_y[e];
+        bool is_inside = x >= 0 && x < MAP_WIDTH && y >= 0 && y < MAP_HEIGHT;
+        int t = is_inside ? y * MAP_WIDTH + x : 0;
+        bool is_ground_gone = !is_inside || tile_age[t * count + e] > ENV_FALL_DELAY_TICKS;
+        done[e] |= move_ticks[e] == 0 && is_ground_gone;
+        episode_ticks[e]++;
+    }
+    return done.data();
+}
+
+void env_batch_t::age_tiles() {
+    uint8_t* age = tile_age.data();
+    size_t size = tile_age.size();
+    size_t i = 0;
+
+    // Resting tiles stay at 0 and gone ones at ENV_FALL_TICKS + 1, the rest
+    // count up. Unsigned bytes compare through min, a <= b when min(a, b) == a.
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i last = _mm256_set1_epi8((char)ENV_FALL_TICKS);
+    for (; i + 32 <= size; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)&age[i]);
+        __m256i is_falling = _mm256_andnot_si256(_mm256_cmpeq_epi8(a, zero), _mm256_cmpeq_epi8(_mm256_min_epu8(a, last), a));
+        _mm256_storeu_si256((__m256i*)&age[i], _mm256_add_epi8(a, _mm256_and_si256(is_falling, one)));
+    }
+#elif defined(ENV_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i last = _mm_set1_epi8((char)ENV_FALL_TICKS);
+    for (; i + 16 <= size; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)&age[i]);
+        __m128i is_falling = _mm_andnot_si128(_mm_cmpeq_epi8(a, zero), _mm_cmpeq_epi8(_mm_min_epu8(a, last), a));
+        _mm_storeu_si128((__m128i*)&age[i], _mm_add_epi8(a, _mm_and_si128(is_falling, one)));
+    }
+#endif
+
+    for (; i < size; i++) {
+        age[i] += age[i] != 0 && age[i] <= ENV_FALL_TICKS;
+    }
+}
+
+void env_batch_t::observe(float* out) const {
+    // Tile by tile within a block of rows small enough to stay in cache,
+    // so the ages are read in order.
+    const float scale = 1.0f / (ENV_FALL_DELAY_TICKS + 1);
+    for (size_t first = 0; first < count; first += ENV_OBS_BLOCK) {
+        size_t last = min(first + ENV_OBS_BLOCK, count);
+        for (int t = 0; t < ENV_TILES; t++) {
+            const uint8_t* age = &tile_age[t * count];
+            for (size_t e = first; e < last; e++) {
+                out[e * ENV_OBS_SIZE + t] = min(1.0f, age[e] * scale);
+            }
+        }
+    }
+    for (size_t e = 0; e < count; e++) {
+        float* obs = out + e * ENV_OBS_SIZE;
+        obs[ENV_TILES] = player_x[e];
+        obs[ENV_TILES + 1] = player_y[e];
+        obs[ENV_TILES + 2] = move_ticks[e] > 0 ? (float)(ENV_MOVE_TICKS - move_ticks[e]) / ENV_MOVE_TICKS : 0.0f;
+        obs[ENV_TILES + 3] = trap_x[e];
+        obs[ENV_TILES + 4] = trap_y[e];
+    }
+}
+
+uint32_t env_batch_t::checksum() const {
+    uint32_t hash = 2166136261u;
+    auto mix = [&hash](const void* data, size_t size) {
+        const uint8_t* bytes = (const uint8_t*)data;
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+    };
+
+    mix(rng_state.data(), count * sizeof(uint32_t));
+    mix(player_x.data(), count);
+    mix(player_y.data(), count);
+    mix(move_ticks.data(), count);
+    mix(tile_age.data(), tile_age.size());
+    mix(trap_x.data(), count);
+    mix(trap_y.data(), count);
+    mix(done.data(), count);
+    return hash;
+}
+
+int run_env_bench(const env_bench_options_t& options) {
+    if (options.envs <= 0 || options.ticks == 0) {
+        printf("envs: nothing to run\n");
+        return 1;
+    }
+
+    env_batch_t envs(options.envs, options.seed);
+    vector<int8_t> actions(options.envs);
+    vector<float> observations((size_t)options.envs * ENV_OBS_SIZE);
+    uint32_t bot_state = options.seed != 0 ? options.seed : 1;
+    uint64_t episodes = 0;
+    uint64_t episode_ticks = 0;
+
+    // Only step() and observe() are timed, not the bots picking actions.
+    chrono::steady_clock::duration elapsed = chrono::steady_clock::duration::zero();
+    for (uint32_t tick = 0; tick < options.ticks; tick++) {
+        // A hop on one tick in four, in a random direction.
+        for (int e = 0; e < options.envs; e++) {
+            bot_state ^= bot_state << 13;
+            bot_state ^= bot_state >> 17;
+            bot_state ^= bot_state << 5;
+            uint32_t roll = bot_state % 16;
+            actions[e] = roll < 4 ? (int8_t)roll : (int8_t)INPUT_NONE;
+        }
+
+        auto start = chrono::steady_clock::now();
+        const uint8_t* done = envs.step(actions.data());
+        envs.observe(observations.data());
+        elapsed += chrono::steady_clock::now() - start;
+
+        for (int e = 0; e < options.envs; e++) {
+            if (done[e]) {
+                episodes++;
+                episode_ticks += envs.episode_ticks[e];
+            }
+        }
+    }
+    double seconds = chrono::duration<double>(elapsed).count();
+    double steps = (double)options.envs * options.ticks;
+
+    printf("envs: %d environments, %u ticks\n", options.envs, options.ticks);
+    printf("  %.3f s, %.0f env steps/s, %.3f ns/env step\n", seconds, steps / seconds, seconds * 1e9 / steps);
+    printf("  %llu episodes, %.1f ticks on average\n", (unsigned long long)episodes,
+        episodes > 0 ? (double)episode_ticks / episodes : 0.0);
+    printf("  checksum %08x\n", envs.checksum());
+    return 0;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "game.h"
+
+constexpr int ENV_TILES = MAP_WIDTH * MAP_HEIGHT;
+
+// Steps of 1 / TICK_RATE a linear_move of time after delay takes to finish.
+// dt is summed in float like linear_move::step does, and a sum that ends just
+// short of the time costs a step more, as 2 s of fall and 1.5 s of sinking do.
+constexpr int env_move_steps(float time, float delay = 0.0f) {
+    float accum = 0.0f;
+    int steps = 0;
+    while (!(accum - delay >= time)) {
+        accum += 1.0f / TICK_RATE;
+        steps++;
+    }
+    return steps;
+}
+
+// Steps a linear_move leaves its sprite at the start, while accum <= delay.
+constexpr int env_wait_steps(float delay) {
+    float accum = 1.0f / TICK_RATE;
+    int steps = 0;
+    while (accum <= delay) {
+        accum += 1.0f / TICK_RATE;
+        steps++;
+    }
+    return steps;
+}
+
+// game_t's timings in ticks. A falling tile gives way after
+// ENV_FALL_DELAY_TICKS and is gone after ENV_FALL_TICKS. A hop waits
+// ENV_MOVE_DELAY_TICKS before the player leaves its tile, then lands on
+// the next one ENV_MOVE_TICKS after the input. The trap comes up again
+// ENV_TRAP_TICKS after its last attack.
+//
+// game_t::step runs actives.update before it rolls a tile or the trap
+// attacks, so their actions first step on the tick after they start while
+// a hop steps on its input's tick. The tile's age and the trap's countdown
+// already count that earlier tick, which makes up for the one lost, so
+// every count is the steps of its action. The trap's sequence starts
+// sinking on the step after the rise finished, so its two parts add up.
+constexpr int ENV_FALL_DELAY_TICKS = (int)(TILE_FALL_DELAY * TICK_RATE);
+constexpr int ENV_FALL_TICKS = env_move_steps(TILE_FALL_TIME, TILE_FALL_DELAY);
+constexpr int ENV_MOVE_DELAY_TICKS = env_wait_steps(PLAYER_HOP_DELAY);
+constexpr int ENV_MOVE_TICKS = env_move_steps(PLAYER_HOP_TIME, PLAYER_HOP_DELAY);
+constexpr int ENV_TRAP_TICKS = env_move_steps(TRAP_RISE_TIME) + env_move_steps(TRAP_SINK_TIME);
+static_assert(ENV_FALL_TICKS < 255 && ENV_TRAP_TICKS <= 255, "tile ages and trap countdowns are bytes");
+
+// Floats per environment written by observe(): every tile's progress
+// towards giving way, 0 resting to 1 gone, then the player's tile, its hop
+// progress and the trap's tile.
+constexpr int ENV_OBS_SIZE = ENV_TILES + 5;
+
+// Thousands of copies of the MAP_WIDTH x MAP_HEIGHT game stepped in
+// lockstep for bot training. Follows game_t's rules in whole ticks without
+// sprites, actions or the level: one tile falls at a time, the trap pops up
+// on a random tile, and an episode is done when the player's ground is
+// gone or the trap hits it. The rolls are drawn in game_t's order from a
+// per-environment xorshift32 stream, so given the same seed and inputs an
+// episode ends on the tick game_t's player starts falling.
+//
+// State is stored as one array per field, indexed by environment, with
+// tiles stored tile by tile so every pass walks contiguous memory. Nothing
+// is allocated after construction.
+class env_batch_t {
+public:
+    size_t count = 0;
+
+    std::vector<uint32_t> rng_state;
+    std::vector<int8_t> player_x;
+    std::vector<int8_t> player_y;
+    // Ticks left of the current hop and its movedir_e, 0 when standing.
+    std::vector<uint8_t> move_ticks;
+    std::vector<uint8_t> move_dir;
+    // Ticks since a tile started falling, 0 while it rests. tile_age[t * count + env].
+    std::vector<uint8_t> tile_age;
+    // The falling tile, -1 for none.
+    std::vector<int8_t> live_tile;
+    std::vector<int8_t> trap_x;
+    std::vector<int8_t> trap_y;
+    // Ticks until the trap attacks again, 0 attacks on the next step.
+    std::vector<uint8_t> trap_ticks;
+    // Set by the step that ended the episode, the next step starts a new one.
+    std::vector<uint8_t> done;
+    // Ticks survived in the current episode.
+    std::vector<uint32_t> episode_ticks;
+
+    // Environment i rolls from seed + i, like game_t seeded with it.
+    env_batch_t(size_t count, uint32_t seed);
+
+    // Starts the environment over at the map's corner, its rolls go on.
+    void reset(size_t env);
+
+    // Advances every environment one tick. actions[env] is a movedir_e or
+    // INPUT_NONE. Environments done after the last step are reset first.
+    // Returns the done flags.
+    const uint8_t* step(const int8_t* actions);
+
+    // Writes ENV_OBS_SIZE floats per environment, one environment after another.
+    void observe(float* out) const;
+
+    // Fingerprint of every environment's state.
+    uint32_t checksum() const;
+
+private:
+    int random(size_t env);
+
+    // Ages falling tiles, for every environment and tile at once.
+    void age_tiles();
+};
+
+struct env_bench_options_t {
+    int envs = 4096;
+    uint32_t ticks = TICK_RATE * 60;
+    uint32_t seed = 1;
+};
+
+// Steps options.envs environments with random hops for options.ticks ticks
+// and prints environment steps per second, episodes and a checksum.
+int run_env_bench(const env_bench_options_t& options);
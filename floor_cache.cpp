@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <cmath>
+#include "floor_cache.h"
+#include "atlas.h"
+#include "depth.h"
+
+using namespace std;
+
+// A region's tiles fit a rectangle R tiles wide in screen space and half as
+// high, plus the bottom half of the last row's cells.
+static const int REGION_WIDTH = FLOOR_REGION_SIZE * SPRITE_WIDTH;
+static const int REGION_HEIGHT = FLOOR_REGION_SIZE * SPRITE_HEIGHT / 2 + SPRITE_HEIGHT / 2;
+
+// Inverse of to_screen on the floor plane.
+static Vector2 to_tile(Vector2 screen) {
+    return (Vector2){
+        .x = screen.y / (SPRITE_HEIGHT / 2.0f) + screen.x / SPRITE_WIDTH,
+        .y = screen.y / (SPRITE_HEIGHT / 2.0f) - screen.x / SPRITE_WIDTH
+    };
+}
+
+bool floor_cache_t::is_below_floor(const sprite_t* sprite) {
+    return depth_box(sprite).max_h < 0.0f;
+}
+
+void floor_cache_t::invalidate(const game_t& game) {
+    for (size_t i = 0; i < game.changed_tiles.size(); i++) {
+        int idx = game.changed_tiles[i];
+        auto it = regions.find(key(idx % game.width / FLOOR_REGION_SIZE, idx / game.width / FLOOR_REGION_SIZE));
+        if (it != regions.end()) {
+            it->second.is_dirty = true;
+        }
+    }
+}
+
+void floor_cache_t::update(game_t& game, Rectangle view) {
+    frame++;
+
+    // Tile range under the view's corners, one tile of slack for the cells
+    // reaching past their diamond.
+    Vector2 corners[4] = {
+        to_tile((Vector2){view.x, view.y}),
+        to_tile((Vector2){view.x + view.width, view.y}),
+        to_tile((Vector2){view.x, view.y + view.height}),
+        to_tile((Vector2){view.x + view.width, view.y + view.height})
+    };
+    float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+    for (int i = 0; i < 4; i++) {
+        min_x = fminf(min_x, corners[i].x);
+        min_y = fminf(min_y, corners[i].y);
+        max_x = fmaxf(max_x, corners[i].x);
+        max_y = fmaxf(max_y, corners[i].y);
+    }
+    int rx0 = max(0, (int)floorf(min_x) - 1) / FLOOR_REGION_SIZE;
+    int ry0 = max(0, (int)floorf(min_y) - 1) / FLOOR_REGION_SIZE;
+    int rx1 = min(game.width - 1, (int)floorf(max_x) + 1) / FLOOR_REGION_SIZE;
+    int ry1 = min(game.height - 1, (int)floorf(max_y) + 1) / FLOOR_REGION_SIZE;
+
+    visible.clear();
+    for (int ry = ry0; ry <= ry1; ry++) {
+        for (int rx = rx0; rx <= rx1; rx++) {
+            floor_region_t& region = regions[key(rx, ry)];
+            if (region.target.id == 0) {
+                region.target = LoadRenderTexture(REGION_WIDTH, REGION_HEIGHT);
+                region.is_dirty = true;
+            }
+            if (region.is_dirty) {
+                redraw(game, rx, ry, region);
+            }
+            region.last_used = frame;
+            visible.push_back(&region);
+        }
+    }
+
+    evict();
+}
+
+void floor_cache_t::redraw(game_t& game, int rx, int ry, floor_region_t& region) {
+    int x0 = rx * FLOOR_REGION_SIZE, y0 = ry * FLOOR_REGION_SIZE;
+    region.origin = (Vector2){
+        .x = (x0 - y0 - FLOOR_REGION_SIZE + 1) * SPRITE_WIDTH / 2.0f,
+        .y = (x0 + y0) * SPRITE_HEIGHT / 4.0f
+    };
+    region.is_dirty = false;
+
+    BeginTextureMode(region.target);
+        ClearBackground(BLANK);
+        for (int y = y0; y < min(y0 + FLOOR_REGION_SIZE, game.height); y++) {
+            for (int x = x0; x < min(x0 + FLOOR_REGION_SIZE, game.width); x++) {
+                const level_tile_t* cell = game.tile_at(x, y);
+                if (cell == nullptr) {
+                    region.is_dirty = true;
+                    continue;
+                }
+                if (cell->flags & (TILE_FALLING | TILE_FALLEN)) {
+                    continue;
+                }
+                const atlas_frame_t& frame = atlas.frame(cell->atlas_idx, false);
+                Vector2 pos = Vector2Add(to_screen((Vector3){(float)x, (float)y, 0.0f}), frame.offset);
+                DrawTextureRec(atlas.texture, frame.src, Vector2Subtract(pos, region.origin), WHITE);
+            }
+        }
+    EndTextureMode();
+}
+
+void floor_cache_t::draw() {
+    for (size_t i = 0; i < visible.size(); i++) {
+        // Render textures come out upside down.
+        Rectangle src = {0, 0, (float)REGION_WIDTH, -(float)REGION_HEIGHT};
+        DrawTextureRec(visible[i]->target.texture, src, visible[i]->origin, WHITE);
+    }
+}
+
+void floor_cache_t::evict() {
+    while (regions.size() > max(FLOOR_CACHE_REGIONS, visible.size())) {
+        auto oldest = regions.begin();
+        for (auto it = regions.begin(); it != regions.end(); it++) {
+            if (it->second.last_used < oldest->second.last_used) {
+                oldest = it;
+            }
+        }
+        UnloadRenderTexture(oldest->second.target);
+        regions.erase(oldest);
+    }
+}
+
+void floor_cache_t::unload() {
+    for (auto it = regions.begin(); it != regions.end(); it++) {
+        UnloadRenderTexture(it->second.target);
+    }
+    regions.clear();
+    visible.clear();
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include <raylib.h>
+#include "game.h"
+
+// Resting floor tiles are drawn once into a render texture per region of
+// FLOOR_REGION_SIZE x FLOOR_REGION_SIZE tiles and composited from there.
+constexpr int FLOOR_REGION_SIZE = 8;
+// Region textures beyond this are released, least recently drawn first.
+constexpr size_t FLOOR_CACHE_REGIONS = 32;
+
+struct floor_region_t {
+    RenderTexture2D target;
+    Vector2 origin;
+    // Redrawn before its next use. Stays set while part of the region is in a
+    // chunk that hasn't streamed in yet.
+    bool is_dirty = true;
+    uint32_t last_used = 0;
+};
+
+// The static floor layer. Falling tiles, the trap and the player are drawn on
+// top of it as sprites; game_t::changed_tiles invalidates the regions whose
+// tiles started falling.
+class floor_cache_t {
+public:
+    floor_cache_t() {}
+    floor_cache_t(const floor_cache_t&) = delete;
+    floor_cache_t& operator=(const floor_cache_t&) = delete;
+
+    // Marks the regions of the last step's changed_tiles for redrawing. Called
+    // after every step, also when the frame isn't drawn.
+    void invalidate(const game_t& game);
+
+    // Redraws the dirty regions overlapping view, given in world coordinates.
+    // Render textures can't be drawn into inside BeginMode2D, so this comes
+    // before it.
+    void update(game_t& game, Rectangle view);
+
+    // Draws the regions picked by the last update, inside the camera's 2D mode.
+    void draw();
+
+    // Releases every texture, the window must still be open.
+    void unload();
+
+    // Sprites below the floor plane, such as a falling player, are drawn
+    // before the floor so it covers them.
+    static bool is_below_floor(const sprite_t* sprite);
+
+private:
+    std::unordered_map<uint64_t, floor_region_t> regions;
+    std::vector<floor_region_t*> visible;
+    uint32_t frame = 0;
+
+    static uint64_t key(int rx, int ry) {
+        return ((uint64_t)(uint32_t)ry << 32) | (uint32_t)rx;
+    }
+
+    void redraw(game_t& game, int rx, int ry, floor_region_t& region);
+
+    void evict();
+};
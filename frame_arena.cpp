@@ -0,0 +1,64 @@
+#include <algorithm>
+#include <cstdint>
+#include "frame_arena.h"
+
+using namespace std;
+
+static size_t align_up(size_t value, size_t align) {
+    return (value + align - 1) & ~(align - 1);
+}
+
+frame_arena_t::frame_arena_t(size_t capacity)
+: block_size(capacity) {
+    block = (char*)::operator new(block_size);
+}
+
+frame_arena_t::~frame_arena_t() {
+    for (size_t i = 0; i < overflow.size(); i++) {
+        ::operator delete(overflow[i]);
+    }
+    ::operator delete(block);
+}
+
+void* frame_arena_t::allocate(size_t size, size_t align) {
+    size_t start = align_up((uintptr_t)block + offset, align) - (uintptr_t)block;
+    if (start + size <= block_size) {
+        used += start + size - offset;
+        offset = start + size;
+        return block + start;
+    }
+
+    size_t pad = align_up((uintptr_t)overflow_top, align) - (uintptr_t)overflow_top;
+    if (overflow_top == nullptr || pad + size > overflow_left) {
+        size_t chunk = max(size + align, block_size);
+        overflow_top = (char*)::operator new(chunk);
+        overflow_left = chunk;
+        overflow.push_back(overflow_top);
+        pad = align_up((uintptr_t)overflow_top, align) - (uintptr_t)overflow_top;
+    }
+    char* ptr = overflow_top + pad;
+    overflow_top += pad + size;
+    overflow_left -= pad + size;
+    overflow_bytes += pad + size;
+    used += pad + size;
+    return ptr;
+}
+
+void frame_arena_t::reset() {
+    high_water = max(high_water, used);
+    if (!overflow.empty()) {
+        for (size_t i = 0; i < overflow.size(); i++) {
+            ::operator delete(overflow[i]);
+        }
+        overflow.clear();
+        // Sized for the whole frame that overflowed, with some headroom.
+        ::operator delete(block);
+        block_size = align_up(block_size + overflow_bytes + overflow_bytes / 2, 4096);
+        block = (char*)::operator new(block_size);
+        overflow_top = nullptr;
+        overflow_left = 0;
+        overflow_bytes = 0;
+    }
+    offset = 0;
+    used = 0;
+}
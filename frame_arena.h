@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+// Default capacity of a frame_arena_t, enough for a full gather and sort.
+constexpr size_t FRAME_ARENA_SIZE = 1 << 20;
+
+// Bump allocator for data that lives for one frame. Allocating moves a
+// pointer, nothing is freed individually and reset() drops everything at
+// once. Running out chains extra blocks for the rest of the frame, the next
+// reset() grows the arena so they are not needed again.
+class frame_arena_t {
+public:
+    // Bytes handed out since the last reset, and the most seen in a frame.
+    size_t used = 0;
+    size_t high_water = 0;
+
+    explicit frame_arena_t(size_t capacity = FRAME_ARENA_SIZE);
+    frame_arena_t(const frame_arena_t&) = delete;
+    frame_arena_t& operator=(const frame_arena_t&) = delete;
+    ~frame_arena_t();
+
+    void* allocate(size_t size, size_t align);
+
+    // Invalidates everything allocated since the last reset.
+    void reset();
+
+    size_t capacity() const {
+        return block_size;
+    }
+
+private:
+    char* block = nullptr;
+    size_t block_size = 0;
+    size_t offset = 0;
+
+    // Blocks chained this frame after block ran out.
+    std::vector<char*> overflow;
+    char* overflow_top = nullptr;
+    size_t overflow_left = 0;
+    size_t overflow_bytes = 0;
+};
+
+// STL allocator drawing from a frame_arena_t. Default constructed it uses
+// the heap, so containers work the same with or without an arena. The
+// allocator moves and swaps with the container's storage.
+template<typename T>
+class frame_allocator_t {
+public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    frame_arena_t* arena = nullptr;
+
+    frame_allocator_t() {}
+    frame_allocator_t(frame_arena_t* arena) : arena(arena) {}
+
+    template<typename U>
+    frame_allocator_t(const frame_allocator_t<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t n) {
+        if (arena != nullptr) {
+            return (T*)arena->allocate(n * sizeof(T), alignof(T));
+        }
+        return (T*)::operator new(n * sizeof(T));
+    }
+
+    void deallocate(T* ptr, size_t) {
+        if (arena == nullptr) {
+            ::operator delete(ptr);
+        }
+    }
+
+    template<typename U>
+    bool operator==(const frame_allocator_t<U>& other) const {
+        return arena == other.arena;
+    }
+
+    template<typename U>
+    bool operator!=(const frame_allocator_t<U>& other) const {
+        return arena != other.arena;
+    }
+};
+
+template<typename T>
+using frame_vector_t = std::vector<T, frame_allocator_t<T>>;
+
+// Points a container at alloc. A container on an arena is always started
+// over, its storage may be from a frame that was reset since.
+template<typename T>
+void use_allocator(frame_vector_t<T>& v, frame_allocator_t<T> alloc) {
+    if (alloc.arena != nullptr || v.get_allocator() != alloc) {
+        v = frame_vector_t<T>(alloc);
+    }
+}
@@ -0,0 +1,388 @@
+#include <algorithm>
+#include "game.h"
+#include "atlas.h"
+
+using namespace std;
+
+game_frames_t game_frames;
+
+void game_frames_t::resolve(const atlas_t& atlas, const clip_library_t& clips) {
+    auto take = [&atlas](const char* name, int* idx) {
+        int found = atlas.find_frame(name);
+        if (found != -1) {
+            *idx = found;
+        }
+    };
+    take("tile_cracked", &tile_cracked);
+    take("tile", &trap);
+    take("player_0", &player);
+    take("player_3", &player_falling);
+
+    int player_0 = atlas.find_frame("player_0");
+    int eyes_0 = atlas.find_frame("eyes_0");
+    if (player_0 != -1 && eyes_0 != -1) {
+        eyes_offset = eyes_0 - player_0;
+    }
+
+    if (const clip_t* clip = clips.find("player_jump")) {
+        player_jump = clip;
+    }
+}
+
+void on_trap_retracted(void* ent, action_t* action) {
+    trap_t* trap = (trap_t*)ent;
+    trap->is_able_to_attack = true;
+}
+
+void on_trap_attacked(void* ent, action_t* action) {
+    trap_t* trap = (trap_t*)ent;
+    trap->is_attacking = false;
+    trap->is_able_to_attack = false;
+}
+
+void on_player_moved(void* ent, action_t* action) {
+    player_t* ply = (player_t*)ent;
+    ply->is_moving = false;
+}
+
+void on_tile_fallen(void* ent, action_t* action) {
+    tile_t* tile = (tile_t*)ent;
+    if (tile->cell != nullptr) {
+        tile->cell->flags = (tile->cell->flags & ~TILE_FALLING) | TILE_FALLEN;
+    }
+}
+
+game_t::game_t(uint32_t seed, const char* level_path, bool streamed)
+: seed(seed), rng_state(seed != 0 ? seed : 1) {
+    const level_entity_t* player_start = nullptr;
+    const level_entity_t* trap_start = nullptr;
+    if (level_path != nullptr && streamed) {
+        stream = make_unique<chunk_streamer_t>();
+        if (!stream->open(level_path)) {
+            return;
+        }
+        width = stream->width;
+        height = stream->height;
+        player_start = stream->find_entity(LEVEL_ENTITY_PLAYER);
+        trap_start = stream->find_entity(LEVEL_ENTITY_TRAP);
+    } else {
+        if (level_path == nullptr) {
+            level.generate(MAP_WIDTH, MAP_HEIGHT);
+        } else if (!level.open(level_path)) {
+            return;
+        }
+        width = level.width;
+        height = level.height;
+        player_start = level.find_entity(LEVEL_ENTITY_PLAYER);
+        trap_start = level.find_entity(LEVEL_ENTITY_TRAP);
+    }
+
+    planes.resize(width, height);
+    if (stream != nullptr) {
+        planes.fill(PLANE_SOLID);
+    } else {
+        sync_planes(0, 0, width - 1, height - 1);
+    }
+
+    player.active_set = &actives;
+    player.damage = &damage;
+    player.atlas_idx = game_frames.player;
+    player.pos.z = 0;
+    player.footprint.z = PLAYER_HEIGHT;
+    if (player_start != nullptr) {
+        player.pos = (Vector3){player_start->x, player_start->y, player_start->z};
+    }
+
+    // Eye frames follow the player's frames in the atlas.
+    eyes_idx = attachments.attach(&player, &eyes, (Vector3){0, 0, 0}, game_frames.eyes_offset, 1);
+    face(movedir);
+
+    trap.is_able_to_attack = true;
+    trap.damage = &damage;
+    trap.pos = (Vector3){0, 0, -16};
+    trap.atlas_idx = game_frames.trap;
+    if (trap_start != nullptr) {
+        trap.pos = (Vector3){trap_start->x, trap_start->y, trap_start->z};
+    }
+
+    if (stream != nullptr) {
+        stream->focus(player.pos.x, player.pos.y);
+        stream->flush();
+        sync_published();
+    }
+}
+
+game_t::~game_t() {
+    for (size_t i = 0; i < live_tiles.size(); i++) {
+        delete live_tiles[i];
+    }
+    // actives is destroyed before the player, which would remove itself from it.
+    if (player.active_idx != -1) {
+        actives.remove(&player);
+    }
+}
+
+int game_t::random() {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return (int)(rng_state >> 1);
+}
+
+void game_t::step(float dt, int input) {
+    changed_tiles.clear();
+
+    tick_accum += dt;
+    while (tick_accum >= 1.0f / TICK_RATE) {
+        tick_accum -= 1.0f / TICK_RATE;
+        tick++;
+    }
+
+    if (input != INPUT_NONE && !player.is_moving) {
+        player.play_clip(game_frames.player_jump, true);
+
+        Vector3 end = player.pos;
+        switch (input) {
+            case MOVE_SOUTH: end.x += 1; break;
+            case MOVE_WEST: end.y += 1; break;
+            case MOVE_NORTH: end.x -= 1; break;
+            case MOVE_EAST: end.y -= 1; break;
+        }
+        face((movedir_e)input);
+
+        player.set_action(new linear_move(player.pos, end, PLAYER_HOP_TIME, PLAYER_HOP_DELAY, [](float x) { return x; }, on_player_moved), true);
+
+        player.is_moving = true;
+    }
+
+    if (stream != nullptr) {
+        stream->focus(player.pos.x, player.pos.y);
+        stream->pump();
+        sync_published();
+    }
+
+    actives.update(dt);
+
+    // Fallen tiles are off screen for good, only their cell flags remain.
+    for (size_t i = 0; i < live_tiles.size(); i++) {
+        if (live_tiles[i]->cell->flags & TILE_FALLEN) {
+            int x = live_tiles[i]->idx % width, y = live_tiles[i]->idx / width;
+            planes.set(PLANE_SOLID, x, y, false);
+            planes.set(PLANE_FALLING, x, y, false);
+            if (stream != nullptr) {
+                stream->pin(x, y, -1);
+            }
+            delete live_tiles[i];
+            live_tiles[i] = live_tiles.back();
+            live_tiles.pop_back();
+            i--;
+        }
+    }
+
+    if (live_tiles.empty()) {
+        int tile_idx = -1;
+        if (stream == nullptr) {
+            tile_idx = random() % (width*height);
+        } else if (!stream->resident.empty()) {
+            // Only resident chunks are simulated, pick the tile among those.
+            chunk_t* chunk = stream->resident[random() % stream->resident.size()];
+            int local = random() % (CHUNK_SIZE*CHUNK_SIZE);
+            int x = chunk->cx * CHUNK_SIZE + local % CHUNK_SIZE;
+            int y = chunk->cy * CHUNK_SIZE + local / CHUNK_SIZE;
+            if (x < width && y < height) {
+                tile_idx = y * width + x;
+            }
+        }
+
+        level_tile_t* cell = tile_idx != -1 ? tile_at(tile_idx % width, tile_idx / width) : nullptr;
+        if (cell != nullptr && (cell->flags & (TILE_FALLING | TILE_FALLEN)) == 0) {
+            cell->atlas_idx = game_frames.tile_cracked;
+            cell->flags |= TILE_FALLING;
+            cell->fall_tick = (uint8_t)tick;
+            planes.set(PLANE_FALLING, tile_idx % width, tile_idx / width, true);
+            changed_tiles.push_back(tile_idx);
+            if (stream != nullptr) {
+                stream->pin(tile_idx % width, tile_idx / width, 1);
+                stream->mark_dirty(tile_idx % width, tile_idx / width);
+            }
+
+            tile_t* tile = new tile_t();
+            tile->active_set = &actives;
+            tile->damage = &damage;
+            tile->pos = (Vector3){.x = (float)(tile_idx % width), .y = (float)(tile_idx / width), .z = 0.0f};
+            tile->atlas_idx = cell->atlas_idx;
+            tile->cell = cell;
+            tile->idx = tile_idx;
+            Vector3 end = tile->pos;
+            end.z += 512.0f;
+            Vector3 jolted = tile->pos;
+            jolted.z += TILE_JOLT;
+            tile->set_action(make_action(tile_fall_t(
+                linear_move(tile->pos, end, TILE_FALL_TIME, TILE_FALL_DELAY, [](float x) { return x*x; }, on_tile_fallen),
+                repeat_t<tile_rattle_t>(tile_rattle_t(
+                    linear_move(tile->pos, jolted, TILE_JOLT_TIME),
+                    linear_move(jolted, tile->pos, TILE_JOLT_TIME),
+                    wait_t(TILE_RATTLE_PAUSE)
+                ), TILE_RATTLES)
+            )), true);
+            live_tiles.push_back(tile);
+        }
+    }
+
+    if (trap.is_able_to_attack) {
+        trap.mark_dirty();
+        trap.pos.x = random() % width;
+        trap.pos.y = random() % height;
+        Vector3 raised = (Vector3){trap.pos.x, trap.pos.y, trap.pos.z + 16};
+        trap.set_action(make_action(trap_attack_t(
+            linear_move(trap.pos, raised, TRAP_RISE_TIME, 0.0f, [](float x) { return x; }, on_trap_attacked),
+            linear_move(raised, trap.pos, TRAP_SINK_TIME, 0.0f, [](float x) { return x; }, on_trap_retracted)
+        )), true);
+        trap.is_able_to_attack = false;
+
+        if (trap.pos.x == player.pos.x && trap.pos.y == player.pos.y && !player.is_falling) {
+            player.is_moving = 1;
+            player.is_falling = 1;
+
+            player.atlas_idx = game_frames.player_falling;
+
+            Vector3 end = player.pos;
+            end.z += 512.0f;
+            player.set_action(new linear_move(player.pos, end, 2.5f, 0.15f, [](float x) { return x*x; }, on_player_moved), true);
+        }
+    }
+
+    int player_idx = (int)player.pos.y * width + (int)player.pos.x;
+    if (player.pos.x < 0 || player.pos.x >= width || player.pos.y < 0 || player.pos.y >= height) {
+        player_idx = -1;
+    }
+
+    // Ground in a chunk that is still streaming in counts as solid.
+    bool is_ground_gone = player_idx == -1 || !planes.get(PLANE_SOLID, player_idx % width, player_idx / width);
+    if (!is_ground_gone && planes.get(PLANE_FALLING, player_idx % width, player_idx / width)) {
+        const level_tile_t* ground = tile_at(player_idx % width, player_idx / width);
+        if (ground != nullptr) {
+            uint8_t elapsed = (uint8_t)(tick - ground->fall_tick);
+            is_ground_gone = elapsed >= (int)(TILE_FALL_DELAY * TICK_RATE);
+        }
+    }
+
+    if (!player.is_falling && !player.is_moving && is_ground_gone) {
+        player.is_moving = 1;
+        player.is_falling = 1;
+
+        player.atlas_idx = game_frames.player_falling;
+
+        Vector3 end = player.pos;
+        end.z += 512.0f;
+        player.set_action(new linear_move(player.pos, end, 2.5f, 0.15f, [](float x) { return x*x; }, on_player_moved), true);
+    }
+
+    trap.update(dt);
+
+    int trap_idx = -1;
+    if (trap.pos.x >= 0 && trap.pos.x < width && trap.pos.y >= 0 && trap.pos.y < height) {
+        trap_idx = (int)trap.pos.y * width + (int)trap.pos.x;
+    }
+    move_plane_bit(PLANE_TRAPPED, &trapped_idx, trap_idx);
+    move_plane_bit(PLANE_OCCUPIED, &occupied_idx, player.is_falling ? -1 : player_idx);
+
+    frame++;
+}
+
+void game_t::face(movedir_e dir) {
+    movedir = dir;
+    eyes.flip = dir == MOVE_WEST;
+    attachments.attachments[eyes_idx].is_visible = dir == MOVE_SOUTH || dir == MOVE_WEST;
+}
+
+void game_t::sync_planes(int x0, int y0, int x1, int y1) {
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            const level_tile_t* cell = tile_at(x, y);
+            planes.set(PLANE_SOLID, x, y, cell == nullptr || !(cell->flags & TILE_FALLEN));
+            planes.set(PLANE_FALLING, x, y, cell != nullptr && (cell->flags & TILE_FALLING));
+        }
+    }
+}
+
+void game_t::sync_published() {
+    if (!stream->published.empty()) {
+        damage.add_everywhere();
+    }
+    for (size_t i = 0; i < stream->published.size(); i++) {
+        chunk_t* chunk = stream->published[i];
+        int x0 = chunk->cx * CHUNK_SIZE, y0 = chunk->cy * CHUNK_SIZE;
+        sync_planes(x0, y0, min(width, x0 + CHUNK_SIZE) - 1, min(height, y0 + CHUNK_SIZE) - 1);
+    }
+    stream->published.clear();
+}
+
+void game_t::move_plane_bit(tile_plane_e plane, int* idx, int new_idx) {
+    if (*idx == new_idx) {
+        return;
+    }
+    if (*idx != -1) {
+        planes.set(plane, *idx % width, *idx / width, false);
+    }
+    if (new_idx != -1) {
+        planes.set(plane, new_idx % width, new_idx / width, true);
+    }
+    *idx = new_idx;
+}
+
+void game_t::gather(sprite_list_t& sprites, bool with_floor) {
+    sprites.clear();
+
+    int min_x = max(0, (int)player.pos.x - GATHER_RADIUS), max_x = min(width - 1, (int)player.pos.x + GATHER_RADIUS);
+    int min_y = max(0, (int)player.pos.y - GATHER_RADIUS), max_y = min(height - 1, (int)player.pos.y + GATHER_RADIUS);
+
+    // Sized once, growing a list on the frame arena leaves its old storage behind.
+    size_t floor_count = with_floor ? (size_t)max(0, max_x - min_x + 1) * max(0, max_y - min_y + 1) : 0;
+    sprites.reserve(floor_count + live_tiles.size() + 2 + attachments.attachments.size());
+
+    // Reserved up front, sprites keeps pointers into it.
+    tile_sprites.clear();
+    tile_sprites.reserve((2*GATHER_RADIUS + 1) * (2*GATHER_RADIUS + 1));
+    for (int y = min_y; with_floor && y <= max_y; y++) {
+        for (int x = min_x; x <= max_x; x++) {
+            const level_tile_t* cell = tile_at(x, y);
+            if (cell == nullptr || (cell->flags & (TILE_FALLING | TILE_FALLEN))) {
+                continue;
+            }
+            tile_sprites.push_back(sprite_t((Vector3){.x = (float)x, .y = (float)y, .z = 0.0f}, cell->atlas_idx));
+            sprites.push_back(&tile_sprites.back());
+        }
+    }
+
+    for (size_t i = 0; i < live_tiles.size(); i++) {
+        sprites.push_back((sprite_t*)live_tiles[i]);
+    }
+
+    sprites.push_back((sprite_t*)&trap);
+    sprites.push_back((sprite_t*)&player);
+
+    attachments.resolve(sprites);
+}
+
+uint32_t game_t::checksum() {
+    uint32_t hash = 2166136261u;
+    auto mix = [&hash](const void* data, size_t size) {
+        const uint8_t* bytes = (const uint8_t*)data;
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+    };
+
+    mix(&rng_state, sizeof(rng_state));
+    mix(&player.pos, sizeof(player.pos));
+    mix(&player.atlas_idx, sizeof(player.atlas_idx));
+    mix(&trap.pos, sizeof(trap.pos));
+    if (stream == nullptr) {
+        mix(level.tiles, (size_t)width * height * sizeof(level_tile_t));
+    }
+    for (size_t i = 0; i < live_tiles.size(); i++) {
+        mix(&live_tiles[i]->pos, sizeof(live_tiles[i]->pos));
+    }
+    return hash;
+}
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <functional>
+#include <memory>
+#include "baseclasses.h"
+#include "actions.h"
+#include "level.h"
+#include "chunks.h"
+#include "depth.h"
+#include "planes.h"
+
+// Size of the map generated when no level file is given.
+constexpr int MAP_WIDTH = 5;
+constexpr int MAP_HEIGHT = 5;
+
+// Tiles further than this from the player are not handed to the renderer.
+constexpr int GATHER_RADIUS = 32;
+
+// Ticks per second of game_t::tick.
+constexpr int TICK_RATE = 30;
+
+// A falling tile gives way after TILE_FALL_DELAY and drops for TILE_FALL_TIME.
+constexpr float TILE_FALL_DELAY = 1.0f;
+constexpr float TILE_FALL_TIME = 2.0f;
+
+// While it waits to give way, a tile rattles TILE_RATTLES times: a jolt of
+// TILE_JOLT down and back, then a pause. It is done well before the fall
+// takes over at TILE_FALL_DELAY.
+constexpr int TILE_RATTLES = 3;
+constexpr float TILE_JOLT = 2.0f;
+constexpr float TILE_JOLT_TIME = 0.05f;
+constexpr float TILE_RATTLE_PAUSE = 0.1f;
+static_assert(TILE_RATTLES * (2 * TILE_JOLT_TIME + TILE_RATTLE_PAUSE) < TILE_FALL_DELAY, "the rattle must end before the fall");
+
+// A hop waits PLAYER_HOP_DELAY on its tile, then takes PLAYER_HOP_TIME to the next.
+constexpr float PLAYER_HOP_DELAY = 0.5f;
+constexpr float PLAYER_HOP_TIME = 0.8f;
+
+// The trap rises for TRAP_RISE_TIME and sinks back for TRAP_SINK_TIME.
+constexpr float TRAP_RISE_TIME = 0.25f;
+constexpr float TRAP_SINK_TIME = 1.5f;
+
+// Height of the player's depth box in pixels, the cube standing on its tile.
+constexpr float PLAYER_HEIGHT = 24.0f;
+
+enum movedir_e {
+    MOVE_SOUTH, MOVE_WEST, MOVE_NORTH, MOVE_EAST
+};
+
+// Input for a single tick, either one of movedir_e or INPUT_NONE.
+constexpr int INPUT_NONE = -1;
+
+class player_t : public sprite_t, public animatable_t {
+public:
+    bool is_moving = false;
+    bool is_falling = false;
+
+    bool is_idle() override {
+        return sprite_t::is_idle() && !is_animating();
+    }
+
+    void update(float dt) override {
+        step_action(dt);
+        step_animation(this, dt);
+    }
+
+protected:
+    void wake() override {
+        activate();
+    }
+};
+
+// Materialized only while a tile falls; resting tiles are just their
+// level_tile_t cell. Recycled through a pool since one is made per fall.
+class tile_t : public sprite_t, public pooled_t<tile_t> {
+public:
+    level_tile_t* cell = nullptr;
+    int idx = 0;
+};
+
+class trap_t : public sprite_t {
+public:
+    bool is_attacking = false;
+    bool is_able_to_attack = true;
+};
+
+class linear_move : public action_t, public pooled_t<linear_move> {
+public:
+    Vector3 start, end;
+    float accum = 0.0f;
+    float delay = 0.0f;
+    float time = 1.0f;
+    std::function<float(float)> f;
+
+    linear_move(Vector3 start, Vector3 end, float time, float delay = 0.0f, std::function<float(float)> f = [](float x) { return x; }, action_callback_t on_finish = nullptr)
+    : start(start), end(end), time(time), delay(delay), f(f) {
+        this->on_finish = on_finish;
+    }
+
+    bool is_acting() {
+        return accum >= delay;
+    }
+
+    bool is_finished() override {
+        return accum - delay >= time;
+    }
+
+    void step(void* ent, float dt) override {
+        if (is_finished()) {
+            return;
+        }
+
+        sprite_t* sprite = (sprite_t*)ent;
+        accum += dt;
+        float t = fminf(1.0f, fmaxf(0.0f, accum - delay) / time);
+        t = f(t);
+        sprite->pos = Vector3Lerp(start, end, t);
+    }
+
+    void reset() override {
+        accum = 0.0f;
+    }
+};
+
+// The trap rises out of the floor and sinks back, built as one action.
+typedef sequence_t<linear_move, linear_move> trap_attack_t;
+
+// A falling tile's action. The rattle is stepped after the fall, so it
+// moves the tile while the fall's delay still holds it in place. The fall
+// alone decides when the tile is gone.
+typedef sequence_t<linear_move, linear_move, wait_t> tile_rattle_t;
+typedef parallel_t<linear_move, repeat_t<tile_rattle_t>> tile_fall_t;
+
+// Completion callbacks for the game's linear_move actions.
+void on_trap_attacked(void* ent, action_t* action);
+void on_trap_retracted(void* ent, action_t* action);
+void on_player_moved(void* ent, action_t* action);
+void on_tile_fallen(void* ent, action_t* action);
+
+// Atlas frames and clips the game shows, by name from packed atlas metadata
+// when it is loaded. Without it they are the grid atlas' cells and the
+// built-in clips, which is also what headless games use.
+struct game_frames_t {
+    // "tile_cracked", what a tile shows once it starts falling.
+    int tile_cracked = 0;
+    // "tile", the trap is drawn as a tile rising out of the floor.
+    int trap = 1;
+    // "player_0" standing and "player_3" while falling.
+    int player = 2;
+    int player_falling = 5;
+    // "eyes_0" - "player_0", the eyes show the player's frame plus this.
+    int eyes_offset = 9;
+    // "player_jump"
+    const clip_t* player_jump = &CLIP_PLAYER_JUMP;
+
+    // Takes every name atlas and clips have, the rest keep their defaults.
+    void resolve(const atlas_t& atlas, const clip_library_t& clips);
+};
+
+extern game_frames_t game_frames;
+
+// One self-contained play session: map, player, trap and the RNG driving them.
+// Nothing in here touches the window, so it can be stepped headlessly.
+class game_t {
+public:
+    uint32_t seed;
+    uint32_t rng_state;
+    uint32_t frame = 0;
+
+    player_t player;
+    movedir_e movedir = MOVE_SOUTH;
+
+    level_t level;
+    // Set when the level is streamed in chunks instead of mapped as a whole.
+    std::unique_ptr<chunk_streamer_t> stream;
+    int width = 0;
+    int height = 0;
+    // At most one tile falls at a time.
+    std::vector<tile_t*> live_tiles;
+
+    // Simulated time in TICK_RATE ticks, stamped into falling tiles' cells.
+    uint32_t tick = 0;
+    float tick_accum = 0.0f;
+
+    // The player and animating tiles. The trap attacks and retracts without
+    // pause and is stepped on its own after the attack logic.
+    active_set_t actives;
+
+    trap_t trap;
+    sprite_t eyes;
+
+    // Where the sprites changed since the renderer last cleared it. Eyes
+    // follow the player, so the player's changes cover theirs.
+    damage_t damage;
+
+    // Parts drawn on top of other sprites, the eyes on the player.
+    attachment_set_t attachments;
+
+    // Stand-in sprites for resting tiles, refilled by every gather().
+    std::vector<sprite_t> tile_sprites;
+
+    // Per-cell solid, falling, trapped and occupied bits for word-parallel
+    // queries. Cells of chunks not streamed in yet count as solid.
+    tile_planes_t planes;
+
+    // Tiles whose look on the floor changed during the last step(), for
+    // renderers caching the floor. Cleared when the next step starts.
+    std::vector<int> changed_tiles;
+
+    // Plays on the level file at level_path, or a generated MAP_WIDTH x MAP_HEIGHT floor.
+    // Streamed levels only simulate and draw the chunks resident around the player.
+    game_t(uint32_t seed, const char* level_path = nullptr, bool streamed = false);
+    game_t(const game_t&) = delete;
+    game_t& operator=(const game_t&) = delete;
+    ~game_t();
+
+    bool is_loaded() {
+        return width > 0;
+    }
+
+    // nullptr outside the map or, when streaming, in a chunk that isn't resident.
+    level_tile_t* tile_at(int x, int y) {
+        if (x < 0 || y < 0 || x >= width || y >= height) {
+            return nullptr;
+        }
+        if (stream != nullptr) {
+            return stream->tile_at(x, y);
+        }
+        return &level.at(x, y);
+    }
+
+    // Nearest cell the player could move to and stay on for a while.
+    bool find_safe_tile(int x, int y, int radius, int* out_x, int* out_y) {
+        return planes.find_nearest(QUERY_SAFE, x, y, radius, out_x, out_y);
+    }
+
+    // xorshift32, so a recorded seed reproduces the session on any platform.
+    int random();
+
+    void step(float dt, int input);
+
+    // Collects everything to draw. Without with_floor the resting tiles are
+    // left out for a renderer that draws the floor on its own.
+    void gather(sprite_list_t& sprites, bool with_floor = true);
+
+    // Cheap fingerprint of the simulation state, compared between replays.
+    uint32_t checksum();
+
+private:
+    int trapped_idx = -1;
+    int occupied_idx = -1;
+    size_t eyes_idx = 0;
+
+    // Turns the player, the eyes only show facing south or west.
+    void face(movedir_e dir);
+
+    // Copies solid and falling bits from cells, for a level or a new chunk.
+    void sync_planes(int x0, int y0, int x1, int y1);
+
+    // Syncs the chunks the streamer made resident since the last call.
+    void sync_published();
+
+    // Moves a single-cell plane's bit from *idx to idx.
+    void move_plane_bit(tile_plane_e plane, int* idx, int new_idx);
+};
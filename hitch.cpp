@@ -0,0 +1,100 @@
+#include "hitch.h"
+
+using namespace std;
+
+static float ms_between(chrono::steady_clock::time_point from, chrono::steady_clock::time_point to) {
+    return chrono::duration<float, milli>(to - from).count();
+}
+
+hitch_detector_t::~hitch_detector_t() {
+    close();
+}
+
+bool hitch_detector_t::open(const char* path, float threshold_ms) {
+    close();
+    log = fopen(path, "a");
+    if (log == nullptr) {
+        return false;
+    }
+    this->threshold_ms = threshold_ms;
+    ring.assign(HITCH_HISTORY, frame_record_t{});
+    ring_next = 0;
+    record = frame_record_t{};
+    frame_start = chrono::steady_clock::now();
+    return true;
+}
+
+void hitch_detector_t::close() {
+    if (log != nullptr) {
+        fclose(log);
+        log = nullptr;
+    }
+}
+
+void hitch_detector_t::begin(perf_phase_e phase) {
+    if (log != nullptr) {
+        phase_start[phase] = chrono::steady_clock::now();
+    }
+}
+
+void hitch_detector_t::end(perf_phase_e phase) {
+    if (log != nullptr) {
+        record.phase_ms[phase] += ms_between(phase_start[phase], chrono::steady_clock::now());
+    }
+}
+
+void hitch_detector_t::begin_wait() {
+    if (log != nullptr) {
+        wait_start = chrono::steady_clock::now();
+    }
+}
+
+void hitch_detector_t::end_wait() {
+    if (log != nullptr) {
+        record.wait_ms += ms_between(wait_start, chrono::steady_clock::now());
+    }
+}
+
+void hitch_detector_t::restart_frame() {
+    frame_start = chrono::steady_clock::now();
+}
+
+void hitch_detector_t::end_frame() {
+    if (log == nullptr) {
+        return;
+    }
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    record.total_ms = ms_between(frame_start, now);
+    frame_start = now;
+
+    ring[ring_next] = record;
+    ring_next = (ring_next + 1) % ring.size();
+    if (record.total_ms - record.wait_ms > threshold_ms) {
+        hitch_count++;
+        write_hitch();
+    }
+    record = frame_record_t{};
+}
+
+void hitch_detector_t::write_hitch() {
+    fprintf(log, "hitch at frame %u: %.2f ms of work, threshold %.2f ms\n", record.frame, record.total_ms - record.wait_ms, threshold_ms);
+    fprintf(log, "  %8s %8s %8s %8s", "frame", "dt ms", "total ms", "wait ms");
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        fprintf(log, " %8s", PERF_PHASE_NAMES[p]);
+    }
+    fprintf(log, " %8s %8s %8s %8s\n", "actives", "tiles", "sprites", "allocs");
+
+    // Oldest first, the hitch itself last. Slots never filled are skipped.
+    for (size_t i = 0; i < ring.size(); i++) {
+        const frame_record_t& r = ring[(ring_next + i) % ring.size()];
+        if (r.total_ms == 0.0f) {
+            continue;
+        }
+        fprintf(log, "%c %8u %8.2f %8.2f %8.2f", i + 1 == ring.size() ? '*' : ' ', r.frame, r.dt_ms, r.total_ms, r.wait_ms);
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            fprintf(log, " %8.3f", r.phase_ms[p]);
+        }
+        fprintf(log, " %8u %8u %8u %8llu\n", r.actives, r.live_tiles, r.sprites, (unsigned long long)r.allocs);
+    }
+    fflush(log);
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "perf_counters.h"
+
+// Frames kept for context in front of a logged hitch.
+constexpr size_t HITCH_HISTORY = 60;
+
+// What a frame spent and what it had to deal with.
+struct frame_record_t {
+    uint32_t frame;
+    // The dt the game was stepped with, and the frame's wall time.
+    float dt_ms;
+    float total_ms;
+    // Spent idle waiting for the frame cap, part of total_ms.
+    float wait_ms;
+    float phase_ms[PHASE_COUNT];
+    uint32_t actives;
+    uint32_t live_tiles;
+    uint32_t sprites;
+    uint64_t allocs;
+};
+
+// Times every frame and its phases into a ring of the last HITCH_HISTORY
+// frames. A frame whose work, its wall time less the frame cap's wait, ran
+// over threshold_ms is appended to the log file together with the frames
+// before it, so the slow frame can be told from its neighbours after the
+// fact.
+class hitch_detector_t {
+public:
+    float threshold_ms = 0.0f;
+    uint32_t hitch_count = 0;
+
+    hitch_detector_t() {}
+    hitch_detector_t(const hitch_detector_t&) = delete;
+    hitch_detector_t& operator=(const hitch_detector_t&) = delete;
+    ~hitch_detector_t();
+
+    // Appends to the log at path. Until then every call is a no-op.
+    bool open(const char* path, float threshold_ms);
+
+    void close();
+
+    bool is_open() const {
+        return log != nullptr;
+    }
+
+    void begin(perf_phase_e phase);
+
+    void end(perf_phase_e phase);
+
+    // Times the idle wait for the frame cap, left out of the threshold.
+    void begin_wait();
+
+    void end_wait();
+
+    // The frame being timed, for the caller to fill in the counts.
+    frame_record_t& current() {
+        return record;
+    }
+
+    // Starts the next frame's clock now, leaving out e.g. loading a level.
+    void restart_frame();
+
+    // Stamps the frame's wall time since the last call and logs it when it
+    // ran over the threshold.
+    void end_frame();
+
+private:
+    FILE* log = nullptr;
+    frame_record_t record = {};
+    std::vector<frame_record_t> ring;
+    size_t ring_next = 0;
+    std::chrono::steady_clock::time_point frame_start;
+    std::chrono::steady_clock::time_point phase_start[PHASE_COUNT];
+    std::chrono::steady_clock::time_point wait_start;
+
+    void write_hitch();
+};
+
+// Times a phase until the end of the scope.
+class hitch_scope_t {
+public:
+    hitch_scope_t(hitch_detector_t& hitches, perf_phase_e phase)
+    : hitches(hitches), phase(phase) {
+        hitches.begin(phase);
+    }
+
+    hitch_scope_t(const hitch_scope_t&) = delete;
+    hitch_scope_t& operator=(const hitch_scope_t&) = delete;
+
+    ~hitch_scope_t() {
+        hitches.end(phase);
+    }
+
+private:
+    hitch_detector_t& hitches;
+    perf_phase_e phase;
+};
@@ -0,0 +1,43 @@
+#include "hud.h"
+
+using namespace std;
+
+hud_t::line_t& hud_t::get_line(int idx) {
+    if (idx >= (int)lines.size()) {
+        lines.resize(idx + 1);
+    }
+    return lines[idx];
+}
+
+char* hud_t::text_buffer(size_t size) {
+    if (arena != nullptr) {
+        return (char*)arena->allocate(size, 1);
+    }
+    if (buffer.size() < size) {
+        buffer.resize(size);
+    }
+    return buffer.data();
+}
+
+void hud_t::render(line_t& line, const char* text) {
+    // ImageText rasterizes the default font at the size DrawText would use.
+    Image image = ImageText(text, line.font_size, RAYWHITE);
+    if (line.texture.id != 0 && line.texture.width == image.width && line.texture.height == image.height) {
+        UpdateTexture(line.texture, image.data);
+    } else {
+        if (line.texture.id != 0) {
+            UnloadTexture(line.texture);
+        }
+        line.texture = LoadTextureFromImage(image);
+    }
+    UnloadImage(image);
+}
+
+void hud_t::unload() {
+    for (size_t i = 0; i < lines.size(); i++) {
+        if (lines[i].texture.id != 0) {
+            UnloadTexture(lines[i].texture);
+        }
+    }
+    lines.clear();
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdio>
+#include <type_traits>
+#include <vector>
+#include <raylib.h>
+#include "frame_arena.h"
+
+// Debug overlay text. Each line remembers the values it was formatted from
+// and keeps its rendered text in a texture, so a line whose values did not
+// change costs one textured quad instead of formatting and drawing glyphs.
+class hud_t {
+public:
+    // Off draws nothing, callers can skip working out their lines too.
+    bool is_visible = true;
+    // Off formats and draws every line every frame, like plain DrawText.
+    bool is_cached = true;
+    // Formatted text goes here when set, else into a buffer kept by the HUD.
+    frame_arena_t* arena = nullptr;
+
+    hud_t() {}
+    hud_t(const hud_t&) = delete;
+    hud_t& operator=(const hud_t&) = delete;
+
+    // Draws printf style text at x, y. Lines are told apart by idx.
+    template<typename... Ts>
+    void text(int idx, int x, int y, int font_size, const char* fmt, Ts... values) {
+        if (!is_visible) {
+            return;
+        }
+        if (!is_cached) {
+            DrawText(format(fmt, values...), x, y, font_size, RAYWHITE);
+            return;
+        }
+
+        key.clear();
+        (append_key(values), ...);
+        line_t& line = get_line(idx);
+        if (line.texture.id == 0 || line.font_size != font_size || line.key != key) {
+            line.key = key;
+            line.font_size = font_size;
+            render(line, format(fmt, values...));
+        }
+        DrawTexture(line.texture, x, y, WHITE);
+    }
+
+    // Releases the line textures, the window must still be open.
+    void unload();
+
+private:
+    struct line_t {
+        std::vector<unsigned char> key;
+        int font_size = 0;
+        Texture2D texture = {0};
+    };
+
+    std::vector<line_t> lines;
+    std::vector<unsigned char> key;
+    std::vector<char> buffer;
+
+    template<typename T>
+    void append_key(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "HUD values are compared bytewise");
+        const unsigned char* bytes = (const unsigned char*)&value;
+        key.insert(key.end(), bytes, bytes + sizeof(T));
+    }
+
+    line_t& get_line(int idx);
+
+    // Formats into text_buffer(), on the frame arena when there is one.
+    template<typename... Ts>
+    const char* format(const char* fmt, Ts... values) {
+        size_t size = (size_t)snprintf(nullptr, 0, fmt, values...) + 1;
+        char* buffer = text_buffer(size);
+        snprintf(buffer, size, fmt, values...);
+        return buffer;
+    }
+
+    char* text_buffer(size_t size);
+
+    void render(line_t& line, const char* text);
+};
@@ -0,0 +1,202 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "level.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static uint64_t align_up(uint64_t value) {
+    return (value + LEVEL_ALIGN - 1) & ~(LEVEL_ALIGN - 1);
+}
+
+level_t::~level_t() {
+    close();
+}
+
+bool level_t::attach(unsigned char* base, size_t size) {
+    if (size < sizeof(level_header_t)) {
+        return false;
+    }
+
+    level_header_t* header = (level_header_t*)base;
+    if (header->magic != LEVEL_MAGIC || header->version != LEVEL_VERSION || header->tile_size != sizeof(level_tile_t)) {
+        return false;
+    }
+
+    uint64_t tiles_size = (uint64_t)header->width * header->height * sizeof(level_tile_t);
+    uint64_t entities_size = (uint64_t)header->entity_count * sizeof(level_entity_t);
+    if (header->tiles_offset + tiles_size > size || header->entities_offset + entities_size > size) {
+        return false;
+    }
+
+    width = header->width;
+    height = header->height;
+    tiles = (level_tile_t*)(base + header->tiles_offset);
+    entities = (const level_entity_t*)(base + header->entities_offset);
+    entity_count = header->entity_count;
+    return true;
+}
+
+bool level_t::open(const char* path) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "Failed to open level %s\n", path);
+        return false;
+    }
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+    HANDLE map = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    CloseHandle(file);
+    if (map == NULL) {
+        fprintf(stderr, "Failed to map level %s\n", path);
+        return false;
+    }
+    void* base = MapViewOfFile(map, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(map);
+    if (base == NULL) {
+        fprintf(stderr, "Failed to map level %s\n", path);
+        return false;
+    }
+    mapping_size = (size_t)file_size.QuadPart;
+#else
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open level %s\n", path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        fprintf(stderr, "Failed to open level %s\n", path);
+        return false;
+    }
+    void* base = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Failed to map level %s\n", path);
+        return false;
+    }
+    mapping_size = st.st_size;
+#endif
+    mapping = base;
+
+    if (!attach((unsigned char*)base, mapping_size)) {
+        fprintf(stderr, "%s is not a valid level\n", path);
+        close();
+        return false;
+    }
+    return true;
+}
+
+void level_t::generate(uint32_t width, uint32_t height) {
+    close();
+
+    level_entity_t placements[] = {
+        {.type = LEVEL_ENTITY_PLAYER, .reserved = 0, .x = 0, .y = 0, .z = 0},
+        {.type = LEVEL_ENTITY_TRAP, .reserved = 0, .x = 0, .y = 0, .z = -16},
+    };
+    uint32_t count = sizeof(placements) / sizeof(placements[0]);
+
+    level_header_t header = {
+        .magic = LEVEL_MAGIC,
+        .version = LEVEL_VERSION,
+        .tile_size = sizeof(level_tile_t),
+        .width = width,
+        .height = height,
+        .tiles_offset = align_up(sizeof(level_header_t)),
+        .entities_offset = 0,
+        .entity_count = count,
+        .reserved = 0
+    };
+    header.entities_offset = align_up(header.tiles_offset + (uint64_t)width * height * sizeof(level_tile_t));
+
+    size_t size = header.entities_offset + count * sizeof(level_entity_t);
+    owned = (unsigned char*)calloc(1, size);
+    memcpy(owned, &header, sizeof(header));
+    memcpy(owned + header.entities_offset, placements, sizeof(placements));
+
+    level_tile_t* cells = (level_tile_t*)(owned + header.tiles_offset);
+    for (size_t i = 0; i < (size_t)width * height; i++) {
+        cells[i] = (level_tile_t){.atlas_idx = 1, .flags = 0};
+    }
+
+    attach(owned, size);
+}
+
+void level_t::close() {
+    if (mapping != nullptr) {
+#ifdef _WIN32
+        UnmapViewOfFile(mapping);
+#else
+        munmap(mapping, mapping_size);
+#endif
+        mapping = nullptr;
+        mapping_size = 0;
+    }
+
+    if (owned != nullptr) {
+        free(owned);
+        owned = nullptr;
+    }
+
+    width = height = 0;
+    tiles = nullptr;
+    entities = nullptr;
+    entity_count = 0;
+}
+
+const level_entity_t* level_t::find_entity(level_entity_type_e type) const {
+    for (uint32_t i = 0; i < entity_count; i++) {
+        if (entities[i].type == type) {
+            return &entities[i];
+        }
+    }
+    return nullptr;
+}
+
+bool level_write(const char* path, uint32_t width, uint32_t height, const level_tile_t* tiles, const level_entity_t* entities, uint32_t entity_count) {
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        return false;
+    }
+
+    level_header_t header = {
+        .magic = LEVEL_MAGIC,
+        .version = LEVEL_VERSION,
+        .tile_size = sizeof(level_tile_t),
+        .width = width,
+        .height = height,
+        .tiles_offset = align_up(sizeof(level_header_t)),
+        .entities_offset = 0,
+        .entity_count = entity_count,
+        .reserved = 0
+    };
+    uint64_t tiles_size = (uint64_t)width * height * sizeof(level_tile_t);
+    header.entities_offset = align_up(header.tiles_offset + tiles_size);
+
+    vector<unsigned char> padding(LEVEL_ALIGN, 0);
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(padding.data(), 1, header.tiles_offset - sizeof(header), file);
+    fwrite(tiles, sizeof(level_tile_t), (size_t)width * height, file);
+    fwrite(padding.data(), 1, header.entities_offset - header.tiles_offset - tiles_size, file);
+    fwrite(entities, sizeof(level_entity_t), entity_count, file);
+
+    bool ok = ferror(file) == 0;
+    fclose(file);
+    return ok;
+}
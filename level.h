@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Binary level file: header, tile array, entity placements. The tile array is
+// laid out exactly as the game uses it (row-major, one level_tile_t per cell),
+// so the file is mapped and used in place without parsing.
+constexpr uint32_t LEVEL_MAGIC = 0x4c564c49; // "ILVL"
+constexpr uint16_t LEVEL_VERSION = 2;
+constexpr uint64_t LEVEL_ALIGN = 64;
+
+enum level_tile_flags_e : uint8_t {
+    TILE_FALLING = 1 << 0,
+    TILE_FALLEN = 1 << 1,
+};
+
+enum level_entity_type_e : uint16_t {
+    LEVEL_ENTITY_PLAYER, LEVEL_ENTITY_TRAP
+};
+
+struct level_header_t {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t tile_size;
+    uint32_t width;
+    uint32_t height;
+    uint64_t tiles_offset;
+    uint64_t entities_offset;
+    uint32_t entity_count;
+    uint32_t reserved;
+};
+
+// Two bytes per cell, its position is the cell's index. fall_tick is the game
+// tick the tile started falling on, wrapped to 8 bits. It is only read while
+// TILE_FALLING is set, which lasts far less than the wrap.
+struct level_tile_t {
+    uint16_t atlas_idx : 6;
+    uint16_t flags : 2;
+    uint16_t fall_tick : 8;
+};
+
+static_assert(sizeof(level_tile_t) == 2, "level_tile_t is mapped straight from level files");
+
+struct level_entity_t {
+    uint16_t type;
+    uint16_t reserved;
+    float x, y, z;
+};
+
+// A level either mapped from a file or generated in memory, both exposing the
+// same tile array. Files are mapped copy-on-write: the game mutates tiles in
+// place and the file on disk is never touched.
+class level_t {
+public:
+    uint32_t width = 0;
+    uint32_t height = 0;
+    level_tile_t* tiles = nullptr;
+    const level_entity_t* entities = nullptr;
+    uint32_t entity_count = 0;
+
+    level_t() {}
+    level_t(const level_t&) = delete;
+    level_t& operator=(const level_t&) = delete;
+    ~level_t();
+
+    bool open(const char* path);
+
+    // Flat floor of width x height tiles with the player and trap at the origin.
+    void generate(uint32_t width, uint32_t height);
+
+    void close();
+
+    const level_entity_t* find_entity(level_entity_type_e type) const;
+
+    level_tile_t& at(int x, int y) {
+        return tiles[(size_t)y * width + x];
+    }
+
+private:
+    void* mapping = nullptr;
+    size_t mapping_size = 0;
+    unsigned char* owned = nullptr;
+
+    bool attach(unsigned char* base, size_t size);
+};
+
+bool level_write(const char* path, uint32_t width, uint32_t height, const level_tile_t* tiles, const level_entity_t* entities, uint32_t entity_count);
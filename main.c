@@ -1,19 +1,90 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <raylib.h>
 #include <raymath.h>
 #include <time.h>
 
-// Implementation from https://gist.github.com/rexim/b5b0c38f53157037923e7cdd77ce685d
-#define da_append(xs, x)                                                             \
+// Growable array of any item type, grown from the da_append in
+// https://gist.github.com/rexim/b5b0c38f53157037923e7cdd77ce685d
+//
+// Dense use: da_append and da_swap_remove keep items[0, count) packed. Removal
+// is O(1) and does not keep the order.
+// Slot use: da_acquire and da_release keep indices stable and hand released
+// slots out again from a free list, for items referred to from elsewhere.
+// da_shrink gives memory back once no more than a quarter is in use.
+#define da_t(T)               \
+    struct {                  \
+        T* items;             \
+        int count;            \
+        int capacity;         \
+        int* free_slots;      \
+        int free_count;       \
+        int free_capacity;    \
+    }
+
+#define DA_MIN_CAPACITY 16
+
+#define da_reserve(xs, n)                                                            \
     do {                                                                             \
-        if ((xs)->count >= (xs)->capacity) {                                         \
-            if ((xs)->capacity == 0) (xs)->capacity = 256;                           \
-            else (xs)->capacity *= 2;                                                \
+        if ((n) > (xs)->capacity) {                                                  \
+            if ((xs)->capacity == 0) (xs)->capacity = DA_MIN_CAPACITY;               \
+            while ((xs)->capacity < (n)) (xs)->capacity *= 2;                        \
             (xs)->items = realloc((xs)->items, (xs)->capacity*sizeof(*(xs)->items)); \
         }                                                                            \
-                                                                                     \
-        (xs)->items[(xs)->count++] = (x);                                            \
+    } while (0)
+
+#define da_append(xs, x)                   \
+    do {                                   \
+        da_reserve((xs), (xs)->count + 1); \
+        (xs)->items[(xs)->count++] = (x);  \
+    } while (0)
+
+#define da_swap_remove(xs, i)                          \
+    do {                                               \
+        (xs)->items[(i)] = (xs)->items[--(xs)->count]; \
+    } while (0)
+
+#define da_shrink(xs)                                                                     \
+    do {                                                                                  \
+        int da_capacity = (xs)->capacity;                                                 \
+        while (da_capacity > DA_MIN_CAPACITY && (xs)->count <= da_capacity / 4) {         \
+            da_capacity /= 2;                                                             \
+        }                                                                                 \
+        if (da_capacity != (xs)->capacity) {                                              \
+            (xs)->capacity = da_capacity;                                                 \
+            (xs)->items = realloc((xs)->items, (xs)->capacity*sizeof(*(xs)->items));      \
+        }                                                                                 \
+    } while (0)
+
+// Stores x in a released slot if there is one, else appends it. The slot's
+// index is written to *idx_out.
+#define da_acquire(xs, x, idx_out)                                     \
+    do {                                                               \
+        if ((xs)->free_count > 0) {                                    \
+            *(idx_out) = (xs)->free_slots[--(xs)->free_count];         \
+        } else {                                                       \
+            da_reserve((xs), (xs)->count + 1);                         \
+            *(idx_out) = (xs)->count++;                                \
+        }                                                              \
+        (xs)->items[*(idx_out)] = (x);                                 \
+    } while (0)
+
+#define da_release(xs, i)                                                                  \
+    do {                                                                                   \
+        if ((xs)->free_count >= (xs)->free_capacity) {                                     \
+            if ((xs)->free_capacity == 0) (xs)->free_capacity = DA_MIN_CAPACITY;           \
+            else (xs)->free_capacity *= 2;                                                 \
+            (xs)->free_slots = realloc((xs)->free_slots, (xs)->free_capacity*sizeof(int)); \
+        }                                                                                  \
+        (xs)->free_slots[(xs)->free_count++] = (i);                                        \
+    } while (0)
+
+#define da_free(xs)                     \
+    do {                                \
+        free((xs)->items);              \
+        free((xs)->free_slots);         \
+        memset((xs), 0, sizeof(*(xs))); \
     } while (0)
 
 
@@ -65,45 +136,96 @@ float fall_func(float x) {
 
 typedef float(*func_t)(float);
 
+// Refers to an entity without pointing into the array holding it. Released
+// slots get a new generation, so stale handles resolve to NULL instead of to
+// whatever reuses the slot. Generations start at 1, a zeroed handle is null.
+typedef struct {
+    int idx;
+    unsigned int generation;
+} handle_t;
+
+typedef struct {
+    sprite_t sprite;
+    int is_moving, is_falling;
+    float fall_time;
+    unsigned int generation;
+    int is_alive;
+} entity_t;
+
+da_t(entity_t) entities = {0};
+
+handle_t entity_create(entity_t entity) {
+    // A reused slot keeps counting from the generation it was released with.
+    unsigned int generation = 1;
+    if (entities.free_count > 0) {
+        generation = entities.items[entities.free_slots[entities.free_count - 1]].generation;
+    }
+
+    int idx;
+    da_acquire(&entities, entity, &idx);
+    entities.items[idx].generation = generation;
+    entities.items[idx].is_alive = 1;
+    return (handle_t){.idx = idx, .generation = entities.items[idx].generation};
+}
+
+entity_t* entity_get(handle_t handle) {
+    if (handle.generation == 0 || handle.idx < 0 || handle.idx >= entities.count) return NULL;
+
+    entity_t* entity = &entities.items[handle.idx];
+    if (!entity->is_alive || entity->generation != handle.generation) return NULL;
+    return entity;
+}
+
+void entity_destroy(handle_t handle) {
+    entity_t* entity = entity_get(handle);
+    if (entity == NULL) return;
+
+    entity->is_alive = 0;
+    entity->generation++;
+    da_release(&entities, handle.idx);
+}
+
+// Moves the target and clears its is_moving once done.
 typedef struct {
     Vector2 start, end;
     float start_z, end_z;
     float accum, delay, time;
-    int* is_moving;
-    Vector2* pos;
-    float* z;
+    handle_t target;
     func_t f;
 } move_t;
 
+// Steps the target's atlas_idx from start_idx to end_idx.
 typedef struct {
     int start_idx, end_idx;
-    int* idx;
-    int* is_animating;
+    handle_t target;
     float accum, delay, time;
 } anim_t;
 
+// Returns 1 once finished, or when the target no longer exists.
 int move_object(move_t* move) {
-    if (!move->is_moving) return 0;
+    entity_t* target = entity_get(move->target);
+    if (target == NULL) return 1;
 
     move->accum += GetFrameTime();
     float t = fminf(1.0f, fmaxf(0.0f, move->accum - move->delay) / move->time);
     if (move->f != NULL) {
         t = move->f(t);
     }
-    *move->pos = Vector2Lerp(move->start, move->end, t);
-    *move->z = move->start_z + (move->end_z - move->start_z) * t;
+    target->sprite.pos = Vector2Lerp(move->start, move->end, t);
+    target->sprite.z = move->start_z + (move->end_z - move->start_z) * t;
     if (move->accum > move->time + move->delay) {
-        *move->is_moving = 0;
+        target->is_moving = 0;
         return 1;
     }
     return 0;
 }
 
 int play_anim(anim_t* anim) {
-    if (!anim->is_animating) return 0;
+    entity_t* target = entity_get(anim->target);
+    if (target == NULL) return 1;
 
     anim->accum += GetFrameTime();
-    *anim->idx = anim->start_idx + (int)((anim->end_idx - anim->start_idx) * fminf(1.0f, fmaxf(0.0f, anim->accum - anim->delay) / anim->time));
+    target->sprite.atlas_idx = anim->start_idx + (int)((anim->end_idx - anim->start_idx) * fminf(1.0f, fmaxf(0.0f, anim->accum - anim->delay) / anim->time));
     if (anim->accum > anim->time + anim->delay) {
         return 1;
     }
@@ -112,35 +234,14 @@ int play_anim(anim_t* anim) {
 }
 
 typedef struct {
-    sprite_t sprite;
+    handle_t entity;
     move_t move;
     anim_t anim;
-    int is_moving, is_falling;
 } player_t;
 
-typedef struct {
-    sprite_t sprite;
-    int is_falling;
-    float fall_time;
-} floor_t;
-
-struct {
-    move_t* items;
-    int count;
-    int capacity;
-} moves = {0};
-
-struct {
-    anim_t* items;
-    int count;
-    int capacity;
-} anims = {0};
-
-struct {
-    sprite_t* items;
-    int count;
-    int capacity;
-} sprites = {0};
+da_t(move_t) moves = {0};
+da_t(anim_t) anims = {0};
+da_t(sprite_t) sprites = {0};
 
 int main(int argc, char* argv[]) {
     const int screen_width = 600;
@@ -163,36 +264,46 @@ int main(int argc, char* argv[]) {
     camera.offset = (Vector2){.x = -1.5*SPRITE_WIDTH + screen_width / 2, .y = 0};
     camera.zoom = 2.0f;
 
+    // The map's tiles and the player live in entities, so moves and anims
+    // keep working when it reallocates.
+    da_reserve(&entities, MAP_HEIGHT*MAP_WIDTH + 1);
+
+    handle_t map[MAP_HEIGHT*MAP_WIDTH] = {0};
+    for (int i = 0; i < MAP_HEIGHT*MAP_WIDTH; i++) {
+        map[i] = entity_create((entity_t){
+            .sprite = (sprite_t){
+                .atlas_idx = 1,
+                .pos = (Vector2){.x = i % MAP_WIDTH, .y = i / MAP_WIDTH},
+                .flip = 0
+            }
+        });
+    }
+
     player_t player = {0};
-    player.sprite.atlas_idx = 2;
-    player.sprite.z = -16.0f;
+    player.entity = entity_create((entity_t){
+        .sprite = (sprite_t){.atlas_idx = 2, .z = -16.0f}
+    });
     movedir_e movedir = MOVE_SOUTH;
 
     anim_t jump_anim = {0};
     jump_anim.start_idx = 2;
     jump_anim.end_idx = 10;
     jump_anim.time = 1.5f;
-    jump_anim.is_animating = &player.sprite.is_animating;
-    jump_anim.idx = &player.sprite.atlas_idx;
+    jump_anim.target = player.entity;
 
     move_t player_move = {0};
     player_move.start_z = -16.0f;
     player_move.end_z = -16.0f;
     player_move.delay = 0.5f;
     player_move.time = 0.8f;
-    player_move.is_moving = &player.is_moving;
-    player_move.pos = &player.sprite.pos;
-    player_move.z = &player.sprite.z;
+    player_move.target = player.entity;
 
-    int dummy;
     move_t player_fall = {0};
     player_fall.start_z = 0.0f;
     player_fall.end_z = 512.0f;
     player_fall.time = 2.5f;
     player_fall.delay = 0.15f;
-    player_fall.is_moving = &dummy;
-    player_fall.pos = &player.sprite.pos;
-    player_fall.z = &player.sprite.z;
+    player_fall.target = player.entity;
     player_fall.f = &fall_func;
 
     move_t tile_fall = {0};
@@ -200,114 +311,120 @@ int main(int argc, char* argv[]) {
     tile_fall.end_z = 512.0f;
     tile_fall.delay = 1.0f;
     tile_fall.time = 2.0f;
-    tile_fall.is_moving = &dummy;
+    tile_fall.f = &fall_func;
 
-    floor_t map[MAP_HEIGHT*MAP_WIDTH] = {0};
-    for (int i = 0; i < MAP_HEIGHT*MAP_WIDTH; i++) {
-        map[i].sprite = (sprite_t){
-            .atlas_idx = 1,
-            .pos = (Vector2){.x = i % MAP_WIDTH, .y = i / MAP_WIDTH},
-            .flip = 0
-        };
-        map[i].is_falling = 0;
-    }
+    // The tile currently falling, destroyed once it has dropped out of view.
+    handle_t falling_tile = {0};
 
-    int is_tile_falling = 0;
+    // The map, the player and its eyes, rebuilt every frame without reallocating.
+    da_reserve(&sprites, MAP_HEIGHT*MAP_WIDTH + 2);
 
     while (!WindowShouldClose()) {
-        if ((IsKeyPressed(KEY_DOWN) || IsKeyPressed(KEY_LEFT) || IsKeyPressed(KEY_UP) || IsKeyPressed(KEY_RIGHT)) && !player.is_moving) {
-            player_move.start = player.sprite.pos;
+        // Entities are only created up front, the player stays valid.
+        entity_t* hero = entity_get(player.entity);
+
+        if ((IsKeyPressed(KEY_DOWN) || IsKeyPressed(KEY_LEFT) || IsKeyPressed(KEY_UP) || IsKeyPressed(KEY_RIGHT)) && !hero->is_moving && !hero->is_falling) {
+            player_move.start = hero->sprite.pos;
             if (IsKeyPressed(KEY_DOWN)) {
-                player_move.end = (Vector2){player.sprite.pos.x + 1, player.sprite.pos.y};
+                player_move.end = (Vector2){hero->sprite.pos.x + 1, hero->sprite.pos.y};
                 movedir = MOVE_SOUTH;
             } else if (IsKeyPressed(KEY_LEFT)) {
-                player_move.end = (Vector2){player.sprite.pos.x, player.sprite.pos.y + 1};
+                player_move.end = (Vector2){hero->sprite.pos.x, hero->sprite.pos.y + 1};
                 movedir = MOVE_WEST;
             } else if (IsKeyPressed(KEY_UP)) {
-                player_move.end = (Vector2){player.sprite.pos.x - 1, player.sprite.pos.y};
+                player_move.end = (Vector2){hero->sprite.pos.x - 1, hero->sprite.pos.y};
                 movedir = MOVE_NORTH;
             } else if (IsKeyPressed(KEY_RIGHT)) {
-                player_move.end = (Vector2){player.sprite.pos.x, player.sprite.pos.y - 1};
+                player_move.end = (Vector2){hero->sprite.pos.x, hero->sprite.pos.y - 1};
                 movedir = MOVE_EAST;
             }
 
             player_move.accum = 0.0f;
-            *player_move.is_moving = 1;
+            hero->is_moving = 1;
             player.move = player_move;
             jump_anim.accum = 0.0f;
-            *jump_anim.is_animating = 1;
-            *jump_anim.idx = jump_anim.start_idx;
+            hero->sprite.is_animating = 1;
+            hero->sprite.atlas_idx = jump_anim.start_idx;
             player.anim = jump_anim;
         }
 
         move_object(&player.move);
         play_anim(&player.anim);
 
-        for (int i = 0; i < moves.count; i++) {
+        // Finished entries are swapped out, the one moved in is processed next.
+        for (int i = 0; i < moves.count;) {
             if (move_object(&moves.items[i])) {
-                for (int j = i; j < moves.count - 1; j++) {
-                    moves.items[j] = moves.items[j + 1];
-                }
-                moves.count--;
-                i--;
+                da_swap_remove(&moves, i);
+            } else {
+                i++;
             }
         }
+        da_shrink(&moves);
 
-        for (int i = 0; i < anims.count; i++) {
+        for (int i = 0; i < anims.count;) {
             if (play_anim(&anims.items[i])) {
-                for (int j = i; j < anims.count - 1; j++) {
-                    anims.items[j] = anims.items[j + 1];
-                }
-                anims.count--;
-                i--;
+                da_swap_remove(&anims, i);
+            } else {
+                i++;
             }
         }
+        da_shrink(&anims);
+
+        entity_t* falling = entity_get(falling_tile);
+        if (falling != NULL && !falling->is_moving) {
+            entity_destroy(falling_tile);
+            falling = NULL;
+        }
 
-        if (!is_tile_falling) {
+        if (falling == NULL) {
             int tile_idx = rand() % (MAP_HEIGHT*MAP_WIDTH);
-            if (!map[tile_idx].is_falling) {
-                is_tile_falling = 1;
-                tile_fall.start = map[tile_idx].sprite.pos;
-                tile_fall.end = map[tile_idx].sprite.pos;
-                tile_fall.pos = &map[tile_idx].sprite.pos;
-                tile_fall.z = &map[tile_idx].sprite.z;
-                tile_fall.is_moving = &is_tile_falling;
-                map[tile_idx].is_falling = 1;
-                map[tile_idx].sprite.atlas_idx = 0;
-                map[tile_idx].fall_time = GetTime();
-                *tile_fall.is_moving = 1;
-                map[tile_idx].sprite.draw_z = 1;
-                tile_fall.f = &fall_func;
+            entity_t* tile = entity_get(map[tile_idx]);
+            if (tile != NULL && !tile->is_falling) {
+                falling_tile = map[tile_idx];
+                tile_fall.accum = 0.0f;
+                tile_fall.start = tile->sprite.pos;
+                tile_fall.end = tile->sprite.pos;
+                tile_fall.target = falling_tile;
+                tile->is_moving = 1;
+                tile->is_falling = 1;
+                tile->sprite.atlas_idx = 0;
+                tile->fall_time = GetTime();
+                tile->sprite.draw_z = 1;
                 da_append(&moves, tile_fall);
             }
         }
 
-        int player_idx = (int)player.sprite.pos.y * MAP_HEIGHT + (int)player.sprite.pos.x;
-        if (player.sprite.pos.x < 0 || player.sprite.pos.x > MAP_WIDTH || player.sprite.pos.y < 0 || player.sprite.pos.y > MAP_HEIGHT) {
+        int player_idx = (int)hero->sprite.pos.y * MAP_WIDTH + (int)hero->sprite.pos.x;
+        if (hero->sprite.pos.x < 0 || hero->sprite.pos.x >= MAP_WIDTH || hero->sprite.pos.y < 0 || hero->sprite.pos.y >= MAP_HEIGHT) {
             player_idx = -1;
         }
 
-        if (!player.is_falling && (player_idx == -1 || map[player_idx].is_falling && GetTime() - map[player_idx].fall_time > tile_fall.delay)) {
-            player.is_moving = 1;
-            player.is_falling = 1;
+        // A destroyed tile has finished falling, its stale handle resolves to NULL.
+        entity_t* ground = player_idx == -1 ? NULL : entity_get(map[player_idx]);
+        if (!hero->is_falling && (ground == NULL || (ground->is_falling && GetTime() - ground->fall_time > tile_fall.delay))) {
+            hero->is_moving = 1;
+            hero->is_falling = 1;
 
-            player.sprite.draw_z = 1;
-            player.sprite.z = 0.0f;
-            player.sprite.atlas_idx = 5;
+            hero->sprite.draw_z = 1;
+            hero->sprite.z = 0.0f;
+            hero->sprite.atlas_idx = 5;
             
             player_fall.accum = 0.0f;
-            player_fall.start = player.sprite.pos;
-            player_fall.end = player.sprite.pos;
+            player_fall.start = hero->sprite.pos;
+            player_fall.end = hero->sprite.pos;
             player.move = player_fall;
         }
 
         sprites.count = 0;
         for (int i = 0; i < MAP_HEIGHT*MAP_WIDTH; i++) {
-            da_append(&sprites, map[i].sprite);
+            entity_t* tile = entity_get(map[i]);
+            if (tile != NULL) {
+                da_append(&sprites, tile->sprite);
+            }
         }
 
-        da_append(&sprites, player.sprite);
-        sprite_t eyes = player.sprite;
+        da_append(&sprites, hero->sprite);
+        sprite_t eyes = hero->sprite;
         eyes.atlas_idx += 9;
         switch (movedir) {
             case MOVE_SOUTH: {
@@ -341,6 +458,11 @@ int main(int argc, char* argv[]) {
         EndDrawing();
     }
 
+    da_free(&moves);
+    da_free(&anims);
+    da_free(&sprites);
+    da_free(&entities);
+
     CloseWindow();
     return 0;
 }
\ No newline at end of file
@@ -3,356 +3,381 @@
 #include <functional>
 #include <memory>
 #include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
 #include <algorithm>
 #include <raylib.h>
 #include <raymath.h>
 #include "baseclasses.h"
+#include "atlas.h"
+#include "game.h"
+#include "replay.h"
+#include "floor_cache.h"
+#include "hud.h"
+#include "alloc_tracker.h"
+#include "perf_counters.h"
+#include "hitch.h"
+#include "redraw.h"
+#include "server.h"
+#include "env_batch.h"
 
 using namespace std;
 
-constexpr int SPRITE_WIDTH = 64;
-constexpr int SPRITE_HEIGHT = 64;
-
-Texture2D atlas_texture = {0};
-int num_tiles_x = 0;
-int num_tiles_y = 0;
-
-constexpr int MAP_WIDTH = 5;
-constexpr int MAP_HEIGHT = 5;
-
 #define VEC3UNPACK(v) v.x, v.y, v.z
 
-enum movedir_e {
-    MOVE_SOUTH, MOVE_WEST, MOVE_NORTH, MOVE_EAST
-};
-
-class player_t : public sprite_t, public animatable_t {
-public:
-    bool is_moving = false;
-    bool is_falling = false;
-
-    void update(float dt) override {
-        if (action != nullptr) {
-            action->step((void*)this, dt);
-        }
-
-        if (anim != nullptr) {
-            anim->step((void*)this, dt);
-        }
-    }
-};
-
-class tile_t : public sprite_t, public animatable_t {
-public:
-    bool* is_falling = nullptr;
-
-    void update(float dt) override {
-        if (action != nullptr) {
-            action->step((void*)this, dt);
-        }
-
-        if (anim != nullptr) {
-            anim->step((void*)this, dt);
-        }
-    }
-};
-
-class trap_t : public sprite_t {
-public:
-    bool is_attacking = false;
-    bool is_able_to_attack = true;
-
-    void update(float dt) override {
-        if (action != nullptr) {
-            action->step((void*)this, dt);
-        }
-    }
-};
-
-class player_move_anim : action_t {
-private:
-    int start_idx = 0, end_idx = 1;
-    float accum = 0.0f;
-    float delay = 0.0f;
-    float time = 1.0f;
-public:
-    player_move_anim(int start_idx, int end_idx, float time, float delay = 0.0f)
-    : start_idx(start_idx), end_idx(end_idx), time(time), delay(delay) {}
-
-    void finish(void* anim_ent) override {}
-
-    bool is_finished() override {
-        return accum - delay >= time;
+int poll_input() {
+    if (IsKeyPressed(KEY_DOWN)) {
+        return MOVE_SOUTH;
+    } else if (IsKeyPressed(KEY_LEFT)) {
+        return MOVE_WEST;
+    } else if (IsKeyPressed(KEY_UP)) {
+        return MOVE_NORTH;
+    } else if (IsKeyPressed(KEY_RIGHT)) {
+        return MOVE_EAST;
     }
+    return INPUT_NONE;
+}
 
-    void step(void* anim_ent, float dt) override {
-        if (is_finished()) {
-            return;
-        }
-
-        sprite_t* sprite = (sprite_t*)anim_ent;
-
-        accum += dt;
-        sprite->atlas_idx = start_idx + (int)((end_idx - start_idx) * fminf(1.0f, fmaxf(0.0f, accum - delay) / time));
-
-        if (is_finished()) {
-            finish(anim_ent);
+int main(int argc, char* argv[]) {
+    const char* record_path = nullptr;
+    const char* replay_path = nullptr;
+    const char* level_path = nullptr;
+    bool streamed = false;
+    bool use_depth_buffer = false;
+    bool use_floor_cache = true;
+    bool use_perf = false;
+    bool always_draw = false;
+    float hitch_ms = 0.0f;
+    const char* hitch_log = "hitches.log";
+    replay_options_t replay;
+    server_options_t server;
+    bool is_server = false;
+    env_bench_options_t env_bench;
+    bool is_env_bench = false;
+    uint32_t seed = (uint32_t)time(0);
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replay_path = argv[++i];
+        } else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) {
+            level_path = argv[++i];
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            streamed = true;
+        } else if (strcmp(argv[i], "--zbuffer") == 0) {
+            use_depth_buffer = true;
+        } else if (strcmp(argv[i], "--no-floor-cache") == 0) {
+            use_floor_cache = false;
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            replay.repeat = atoi(argv[++i]);
+            if (replay.repeat < 1) {
+                fprintf(stderr, "--repeat needs at least 1 run\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--alloc-budget") == 0 && i + 1 < argc) {
+            replay.alloc_budget = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            use_perf = true;
+        } else if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) {
+            is_server = true;
+            server.matches = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            server.threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--envs") == 0 && i + 1 < argc) {
+            is_env_bench = true;
+            env_bench.envs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+            server.ticks = (uint32_t)strtoul(argv[++i], nullptr, 10);
+            env_bench.ticks = server.ticks;
+        } else if (strcmp(argv[i], "--always-draw") == 0) {
+            always_draw = true;
+        } else if (strcmp(argv[i], "--hitch-ms") == 0 && i + 1 < argc) {
+            hitch_ms = (float)atof(argv[++i]);
+        } else if (strcmp(argv[i], "--hitch-log") == 0 && i + 1 < argc) {
+            hitch_log = argv[++i];
+        } else if (strcmp(argv[i], "--check-actions") == 0) {
+            return run_action_check();
         }
     }
-};
-
-class linear_move : action_t {
-public:
-    Vector3 start, end;
-    float accum = 0.0f;
-    float delay = 0.0f;
-    float time = 1.0f;
-    function<float(float)> f;
 
-    linear_move(Vector3 start, Vector3 end, float time, float delay = 0.0f, function<float(float)> f = [](float x) { return x; })
-    : start(start), end(end), time(time), delay(delay), f(f) {}
-
-    bool is_acting() {
-        return accum >= delay;
+    if (replay_path != nullptr) {
+        replay.level_path = level_path;
+        replay.streamed = streamed;
+        replay.use_perf = use_perf;
+        replay.hitch_ms = hitch_ms;
+        replay.hitch_log = hitch_log;
+        return run_replay(replay_path, replay);
     }
 
-    bool is_finished() override {
-        return accum - delay >= time;
+    if (is_server) {
+        server.seed = seed;
+        server.level_path = level_path;
+        return run_server(server);
     }
 
-    void step(void* ent, float dt) override {
-        if (is_finished()) {
-            return;
-        }
-
-        sprite_t* sprite = (sprite_t*)ent;
-        accum += dt;
-        float t = fminf(1.0f, fmaxf(0.0f, accum - delay) / time);
-        t = f(t);
-        sprite->pos = Vector3Lerp(start, end, t);
-
-        if (is_finished()) {
-            finish(ent);
-        }
+    if (is_env_bench) {
+        env_bench.seed = seed;
+        return run_env_bench(env_bench);
     }
-};
 
-class trap_move_back : public linear_move {
-public:
-    trap_move_back(Vector3 start, Vector3 end, float time, float delay = 0.0f, function<float(float)> f = [](float x) { return x; })
-    : linear_move(start, end, time, delay, f) {}
-
-    void finish(void* ent) override {
-        trap_t* trap = (trap_t*)ent;
-        trap->is_able_to_attack = true;
-    }
-};
-
-class trap_move : public linear_move {
-public:
-    trap_move(Vector3 start, Vector3 end, float time, float delay = 0.0f, function<float(float)> f = [](float x) { return x; })
-    : linear_move(start, end, time, delay, f) {}
-
-    void finish(void* ent) override {
-        trap_t* trap = (trap_t*)ent;
-        trap->is_attacking = false;
-        trap->is_able_to_attack = false;
-        trap->set_action(new trap_move_back(end, start, 1.5f), true);
-    }
-};
-
-class player_move : public linear_move {
-public:
-    player_move(Vector3 start, Vector3 end, float time, float delay = 0.0f, function<float(float)> f = [](float x) { return x; })
-    : linear_move(start, end, time, delay, f) {}
-
-    void finish(void* ent) override {
-        player_t* ply = (player_t*)ent;
-        ply->is_moving = false;
-    }
-};
-
-class tile_move : public linear_move {
-public:
-    tile_move(Vector3 start, Vector3 end, float time, float delay = 0.0f, function<float(float)> f = [](float x) { return x; })
-    : linear_move(start, end, time, delay, f) {}
-
-    void finish(void* ent) override {
-        tile_t* tile = (tile_t*)ent;
-        if (tile->is_falling != nullptr) {
-            *tile->is_falling = false;
-        }
-    }
-};
-
-float nearness(sprite_t* sprite) {
-    return sprite->pos.x + sprite->pos.y - sprite->pos.z + sprite->order_z;
-}
-
-int main(int argc, char* argv[]) {
     const int screen_width = 600;
     const int screen_height = 600;
     const char* title = "Iso";
+    const int target_fps = 30;
+    // No SetTargetFPS, EndDrawing would wait for the cap inside the frame.
+    // The loop waits out target_fps itself, timed apart from the frame's work.
     InitWindow(screen_width, screen_height, title);
-    SetTargetFPS(30);
 
-    atlas_texture = LoadTexture("resource/atlas.png");
-    if (atlas_texture.width == 0) {
+    // Prefer the packed atlas, the raw grid still works when it hasn't been built.
+    bool atlas_loaded = FileExists("resource/atlas.meta") ? atlas.load_meta("resource/atlas.meta") : atlas.load("resource/atlas.png");
+    if (!atlas_loaded) {
         TraceLog(LOG_ERROR, "Failed to load atlas.");
         return 1;
     }
 
-    num_tiles_x = atlas_texture.width / SPRITE_WIDTH;
-    num_tiles_y = atlas_texture.height / SPRITE_HEIGHT;
+    clip_library.add_atlas_clips(atlas);
+    game_frames.resolve(atlas, clip_library);
+
+    // Z toggles between sorting on the CPU and ordering with the depth buffer.
+    depth_renderer_t depth_renderer;
+    if (!depth_renderer.load()) {
+        use_depth_buffer = false;
+    }
+
+    // F toggles drawing the resting floor from cached region textures. The
+    // depth buffer mode draws every tile itself.
+    floor_cache_t floor_cache;
+
+    // H hides the HUD, C toggles caching its text.
+    hud_t hud;
+    // The HUD's floor query around the player. With the text cached it is
+    // only redone once the planes or the player's tile changed.
+    struct {
+        bool is_valid = false;
+        uint32_t version = 0;
+        int x = 0, y = 0;
+        size_t walkable = 0;
+        int safe_x = -1, safe_y = -1;
+    } floor_query;
+
+    // Frames where nothing in view moved leave the last one on screen.
+    // --always-draw turns this off, e.g. to profile drawing.
+    redraw_tracker_t redraw;
+    redraw.is_enabled = !always_draw;
 
     Camera2D camera = {0};
     camera.offset = (Vector2){.x = -1.5*SPRITE_WIDTH + screen_width / 2, .y = 0};
     camera.zoom = 2.0f;
 
-    player_t player;
-    player.atlas_idx = 2;
-    player.pos.z = 0;
-    player.order_z = 1;
-    movedir_e movedir = MOVE_SOUTH;
-
-    bool is_tile_falling = 0;
-    tile_t map[MAP_HEIGHT*MAP_WIDTH];
-    for (int i = 0; i < MAP_HEIGHT*MAP_WIDTH; i++) {
-        map[i].pos = (Vector3){.x = i % MAP_WIDTH, .y = i / MAP_WIDTH, .z = 0.0f};
-        map[i].atlas_idx = 1;
-        map[i].is_falling = &is_tile_falling;
+    unique_ptr<game_t> game = make_unique<game_t>(seed, level_path, streamed);
+    if (!game->is_loaded()) {
+        CloseWindow();
+        return 1;
     }
 
-    vector<sprite_t*> sprites;
-
-    trap_t trap;
-    trap.is_able_to_attack = true;
-    trap.pos = (Vector3){0, 0, -16};
-    trap.atlas_idx = 1;
+    // While recording, the simulation runs at the log's fixed tick so the
+    // replay reproduces it exactly regardless of the real frame times.
+    input_log_t log;
+    log.seed = seed;
+
+    // Everything transient in a frame, released after EndDrawing.
+    frame_arena_t frame_arena;
+    hud.arena = &frame_arena;
+    alloc_frame_stats_t alloc_stats;
+    perf_counters_t perf;
+    if (use_perf && !perf.open()) {
+        TraceLog(LOG_WARNING, "perf counters unavailable, see /proc/sys/kernel/perf_event_paranoid.");
+    }
+    hitch_detector_t hitches;
+    if (hitch_ms > 0.0f && !hitches.open(hitch_log, hitch_ms)) {
+        TraceLog(LOG_WARNING, "Can't open %s, hitches are not logged.", hitch_log);
+    }
 
+    // GetFrameTime() is only updated by drawn frames, skipped ones would
+    // leave it stale and have the next drawn frame count the idle time twice.
+    double frame_start = GetTime();
     while (!WindowShouldClose()) {
-        float dt = GetFrameTime();
-
-        if ((IsKeyPressed(KEY_DOWN) || IsKeyPressed(KEY_LEFT) || IsKeyPressed(KEY_UP) || IsKeyPressed(KEY_RIGHT)) && !player.is_moving) {
-            player.set_animation(new player_move_anim(2, 10, 1.5f), true);
-
-            Vector3 end = player.pos;
-            if (IsKeyPressed(KEY_DOWN)) {
-                end.x += 1;
-                movedir = MOVE_SOUTH;
-            } else if (IsKeyPressed(KEY_LEFT)) {
-                end.y += 1;
-                movedir = MOVE_WEST;
-            } else if (IsKeyPressed(KEY_UP)) {
-                end.x -= 1;
-                movedir = MOVE_NORTH;
-            } else if (IsKeyPressed(KEY_RIGHT)) {
-                end.y -= 1;
-                movedir = MOVE_EAST;
-            }
-
-            player.set_action(new player_move(player.pos, end, 0.8f, 0.5f), true);
-
-            player.is_moving = true;
+        double now = GetTime();
+        float dt = (float)(now - frame_start);
+        frame_start = now;
+        int input = poll_input();
+        if (IsKeyPressed(KEY_Z) && depth_renderer.is_loaded()) {
+            use_depth_buffer = !use_depth_buffer;
+            redraw.invalidate();
         }
-
-        player.update(dt);
-
-        for (int i = 0; i < MAP_HEIGHT*MAP_WIDTH; i++) {
-            map[i].update(dt);
+        if (IsKeyPressed(KEY_F)) {
+            use_floor_cache = !use_floor_cache;
+            // Changes made while off would go unnoticed.
+            floor_cache.unload();
+            redraw.invalidate();
         }
-
-        if (!is_tile_falling) {
-            int tile_idx = rand() % (MAP_HEIGHT*MAP_WIDTH);
-            if (map[tile_idx].action == nullptr) {
-                is_tile_falling = 1;
-                map[tile_idx].atlas_idx = 0;
-                Vector3 end = map[tile_idx].pos;
-                end.z += 512.0f;
-                map[tile_idx].set_action(new tile_move(map[tile_idx].pos, end, 2.0f, 1.0f, [](float x) { return x*x; }), true);
-            }
+        if (IsKeyPressed(KEY_H)) {
+            hud.is_visible = !hud.is_visible;
+            redraw.invalidate();
+        }
+        if (IsKeyPressed(KEY_C)) {
+            hud.is_cached = !hud.is_cached;
+            redraw.invalidate();
         }
 
-        if (trap.is_able_to_attack) {
-            trap.pos.x = rand() % MAP_WIDTH;
-            trap.pos.y = rand() % MAP_HEIGHT;
-            trap.set_action(new trap_move(trap.pos, (Vector3){trap.pos.x, trap.pos.y, trap.pos.z + 16}, 0.25f), true);
-            trap.is_able_to_attack = false;
-
-            if (trap.pos.x == player.pos.x && trap.pos.y == player.pos.y && !player.is_falling) {
-                player.is_moving = 1;
-                player.is_falling = 1;
+        if (record_path != nullptr) {
+            dt = 1.0f / log.tick_rate;
+            log.record(game->frame, input);
+        }
 
-                player.order_z = 0;
-                player.atlas_idx = 5;
+        {
+            alloc_scope_t scope(ALLOC_SIM);
+            perf_scope_t perf_scope(perf, PHASE_UPDATE);
+            hitch_scope_t hitch_scope(hitches, PHASE_UPDATE);
+            game->step(dt, input);
+        }
 
-                Vector3 end = player.pos;
-                end.z += 512.0f;
-                player.set_action(new player_move(player.pos, end, 2.5f, 0.15f, [](float x) { return x*x; }), true);                
-            }
+        // Level files can be far bigger than the screen, keep the player in view.
+        if (level_path != nullptr) {
+            camera.offset = (Vector2){.x = screen_width / 2.0f, .y = screen_height / 2.0f};
+            camera.target = Vector2Add(to_screen(game->player.pos), (Vector2){SPRITE_WIDTH / 2.0f, SPRITE_HEIGHT / 4.0f});
         }
 
-        int player_idx = (int)player.pos.y * MAP_HEIGHT + (int)player.pos.x;
-        if (player.pos.x < 0 || player.pos.x > MAP_WIDTH || player.pos.y < 0 || player.pos.y > MAP_HEIGHT) {
-            player_idx = -1;
+        floor_cache.invalidate(*game);
+
+        bool is_floor_cached = use_floor_cache && !use_depth_buffer;
+        sprite_list_t sprites(&frame_arena);
+        {
+            alloc_scope_t scope(ALLOC_GATHER);
+            perf_scope_t perf_scope(perf, PHASE_GATHER);
+            hitch_scope_t hitch_scope(hitches, PHASE_GATHER);
+            game->gather(sprites, !is_floor_cached);
         }
 
-        if (!player.is_falling && !player.is_moving && (player_idx == -1 || map[player_idx].action != nullptr && ((tile_move*)&map[player_idx].action)->is_acting())) {
-            player.is_moving = 1;
-            player.is_falling = 1;
+        Vector2 view_min = GetScreenToWorld2D((Vector2){0, 0}, camera);
+        Vector2 view_max = GetScreenToWorld2D((Vector2){(float)screen_width, (float)screen_height}, camera);
+        Rectangle view = (Rectangle){view_min.x, view_min.y, view_max.x - view_min.x, view_max.y - view_min.y};
+
+        if (!redraw.needs_redraw(game->damage, camera, view)) {
+            // The last frame stays up, input is polled as EndDrawing would.
+            PollInputEvents();
+        } else {
+            if (!use_depth_buffer) {
+                alloc_scope_t scope(ALLOC_SORT);
+                perf_scope_t perf_scope(perf, PHASE_SORT);
+                hitch_scope_t hitch_scope(hitches, PHASE_SORT);
+                sort_sprites(sprites, &frame_arena);
+            }
 
-            player.order_z = 0;
-            player.atlas_idx = 5;
+            trap_t& trap = game->trap;
 
-            Vector3 end = player.pos;
-            end.z += 512.0f;
-            player.set_action(new player_move(player.pos, end, 2.5f, 0.15f, [](float x) { return x*x; }), true);
+            // Charged to rendering for the rest of the frame, the HUD aside.
+            alloc_scope_t render_scope(ALLOC_RENDER);
+            // Up to EndDrawing, which presents the frame.
+            perf.begin(PHASE_DRAW);
+            hitches.begin(PHASE_DRAW);
+            BeginDrawing();
+                if (is_floor_cached) {
+                    floor_cache.update(*game, view);
+                }
+                ClearBackground(BLACK);
+                BeginMode2D(camera);
+                    if (use_depth_buffer) {
+                        depth_renderer.draw(sprites);
+                    } else if (is_floor_cached) {
+                        // Sorted order is kept within both passes.
+                        for (size_t i = 0; i < sprites.size(); i++) {
+                            if (floor_cache_t::is_below_floor(sprites[i])) {
+                                sprites[i]->draw();
+                            }
+                        }
+                        floor_cache.draw();
+                        for (size_t i = 0; i < sprites.size(); i++) {
+                            if (!floor_cache_t::is_below_floor(sprites[i])) {
+                                sprites[i]->draw();
+                            }
+                        }
+                    } else {
+                        for (size_t i = 0; i < sprites.size(); i++) {
+                            sprites[i]->draw();
+                        }
+                    }
+                EndMode2D();
+                if (hud.is_visible) {
+                    alloc_scope_t scope(ALLOC_HUD);
+                    hud.text(0, 0, 16, 16, "trap: %d, %d, %p", trap.is_able_to_attack, trap.is_attacking, trap.action);
+                    if (trap.action != nullptr) {
+                        linear_move* move = (linear_move*)((trap_attack_t*)trap.action)->active();
+                        hud.text(1, 0, 32, 16, "(%f, %f, %f) -> (%f, %f, %f)", VEC3UNPACK(move->start), VEC3UNPACK(move->end));
+                    }
+                    int px = (int)game->player.pos.x, py = (int)game->player.pos.y;
+                    if (!hud.is_cached || !floor_query.is_valid || floor_query.version != game->planes.version
+                        || floor_query.x != px || floor_query.y != py) {
+                        floor_query.is_valid = true;
+                        floor_query.version = game->planes.version;
+                        floor_query.x = px;
+                        floor_query.y = py;
+                        floor_query.safe_x = floor_query.safe_y = -1;
+                        game->find_safe_tile(px, py, GATHER_RADIUS, &floor_query.safe_x, &floor_query.safe_y);
+                        floor_query.walkable = game->planes.count(QUERY_WALKABLE, px - GATHER_RADIUS, py - GATHER_RADIUS,
+                            px + GATHER_RADIUS, py + GATHER_RADIUS);
+                    }
+                    hud.text(2, 0, 48, 16, "walkable: %zu, safe: %d, %d", floor_query.walkable, floor_query.safe_x, floor_query.safe_y);
+                    if (ALLOC_TRACKING) {
+                        hud.text(3, 0, 64, 16, "allocs: %llu (sim %llu, render %llu), live %lld KB, peak %lld KB",
+                            (unsigned long long)alloc_stats.frame_total, (unsigned long long)alloc_stats.frame[ALLOC_SIM],
+                            (unsigned long long)alloc_stats.frame[ALLOC_RENDER],
+                            (long long)alloc_stats.live_bytes / 1024, (long long)alloc_stats.peak_bytes / 1024);
+                    }
+                    if (perf.is_open()) {
+                        auto ipc = [&perf](perf_phase_e phase) {
+                            const uint64_t* v = perf.last[phase].values;
+                            return v[PERF_CYCLES] > 0 ? (double)v[PERF_INSTRUCTIONS] / v[PERF_CYCLES] : 0.0;
+                        };
+                        hud.text(4, 0, 80, 16, "ipc: update %.2f, gather %.2f, sort %.2f, draw %.2f",
+                            ipc(PHASE_UPDATE), ipc(PHASE_GATHER), ipc(PHASE_SORT), ipc(PHASE_DRAW));
+                    }
+                }
+                perf.end(PHASE_DRAW);
+                hitches.end(PHASE_DRAW);
+            EndDrawing();
         }
 
-        sprites.clear();
-        for (int i = 0; i < MAP_HEIGHT*MAP_WIDTH; i++) {
-            sprites.push_back((sprite_t*)&map[i]);
+        // Drawn or not, the rest of the frame budget is idle.
+        double left = 1.0 / target_fps - (GetTime() - frame_start);
+        if (left > 0.0) {
+            hitches.begin_wait();
+            WaitTime(left);
+            hitches.end_wait();
         }
 
-        trap.update(dt);
-
-        sprites.push_back((sprite_t*)&trap);
-        sprites.push_back((sprite_t*)&player);
-        sprite_t eyes;
-        eyes.pos = player.pos;
-        eyes.order_z = player.order_z + 1;
-        eyes.atlas_idx = player.atlas_idx + 9;
-        switch (movedir) {
-            case MOVE_SOUTH: {
-                eyes.flip = false;
-                sprites.push_back((sprite_t*)&eyes);
-            } break;
-            case MOVE_WEST: {
-                eyes.flip = true;
-                sprites.push_back((sprite_t*)&eyes);
-            } break;
-            default: break;
-        }
+        // sprites lives on the frame arena, its count is taken before the reset.
+        size_t sprite_count = sprites.size();
+        frame_arena.reset();
+        alloc_stats.end_frame();
+        perf.end_frame(sprite_count);
+
+        frame_record_t& record = hitches.current();
+        record.frame = game->frame;
+        record.dt_ms = dt * 1000.0f;
+        record.actives = (uint32_t)game->actives.members.size();
+        record.live_tiles = (uint32_t)game->live_tiles.size();
+        record.sprites = (uint32_t)sprite_count;
+        record.allocs = alloc_stats.frame_total;
+        hitches.end_frame();
+    }
 
-        sort(sprites.begin(), sprites.end(), [](sprite_t* a, sprite_t* b) {
-            return nearness(a) < nearness(b);
-        });
+    if (perf.is_open()) {
+        printf("perf counters over %llu frames:\n", (unsigned long long)perf.frames);
+        perf.report(stdout);
+    }
 
-        BeginDrawing();
-            ClearBackground(BLACK);
-            BeginMode2D(camera);
-                for (size_t i = 0; i < sprites.size(); i++) {
-                    sprites[i]->draw();
-                }
-            EndMode2D();
-            DrawText(TextFormat("trap: %d, %d, %p", trap.is_able_to_attack, trap.is_attacking, trap.action), 0, 16, 16, RAYWHITE);
-            if (trap.action != nullptr) {
-                linear_move* move = (linear_move*)trap.action;
-                DrawText(TextFormat("(%f, %f, %f) -> (%f, %f, %f)", VEC3UNPACK(move->start), VEC3UNPACK(move->end)), 0, 32, 16, RAYWHITE);
-            }
-        EndDrawing();
+    if (record_path != nullptr && log.save(record_path)) {
+        TraceLog(LOG_INFO, "Recorded %u frames, %zu inputs to %s.", log.frame_count, log.events.size(), record_path);
     }
 
+    hud.unload();
+    floor_cache.unload();
+    depth_renderer.unload();
+    atlas.unload();
     CloseWindow();
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,133 @@
+#include <cstring>
+#include "perf_counters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+const char* const PERF_PHASE_NAMES[PHASE_COUNT] = {
+    "update", "gather", "sort", "draw"
+};
+
+perf_counters_t::~perf_counters_t() {
+    close();
+}
+
+#ifdef __linux__
+
+static const uint64_t EVENT_CONFIGS[PERF_EVENT_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+};
+
+bool perf_counters_t::open() {
+    close();
+    for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = EVENT_CONFIGS[e];
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.disabled = e == 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        // The calling thread on any CPU, all events in one group read at once.
+        fds[e] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, e == 0 ? -1 : fds[0], 0);
+        if (fds[e] == -1) {
+            close();
+            return false;
+        }
+    }
+    group_fd = fds[0];
+    ioctl(group_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(group_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+
+void perf_counters_t::close() {
+    for (int e = PERF_EVENT_COUNT - 1; e >= 0; e--) {
+        if (fds[e] != -1) {
+            ::close(fds[e]);
+            fds[e] = -1;
+        }
+    }
+    group_fd = -1;
+}
+
+bool perf_counters_t::read(perf_sample_t* sample) const {
+    // PERF_FORMAT_GROUP: the number of events, then their values in order.
+    uint64_t buffer[1 + PERF_EVENT_COUNT];
+    if (::read(group_fd, buffer, sizeof(buffer)) != (ssize_t)sizeof(buffer)) {
+        return false;
+    }
+    memcpy(sample->values, buffer + 1, sizeof(sample->values));
+    return true;
+}
+
+#else
+
+bool perf_counters_t::open() {
+    return false;
+}
+
+void perf_counters_t::close() {
+}
+
+bool perf_counters_t::read(perf_sample_t* sample) const {
+    return false;
+}
+
+#endif
+
+void perf_counters_t::begin(perf_phase_e phase) {
+    if (is_open()) {
+        read(&start[phase]);
+    }
+}
+
+void perf_counters_t::end(perf_phase_e phase) {
+    perf_sample_t now;
+    if (!is_open() || !read(&now)) {
+        return;
+    }
+    for (int e = 0; e < PERF_EVENT_COUNT; e++) {
+        uint64_t delta = now.values[e] - start[phase].values[e];
+        current[phase].values[e] += delta;
+        totals[phase].values[e] += delta;
+    }
+}
+
+void perf_counters_t::end_frame(size_t entity_count) {
+    frames++;
+    entities += entity_count;
+    memcpy(last, current, sizeof(last));
+    memset(current, 0, sizeof(current));
+}
+
+void perf_counters_t::report(FILE* out) const {
+    if (frames == 0) {
+        return;
+    }
+    fprintf(out, "  %-8s %12s %8s %6s %14s %14s %12s %12s\n", "phase", "cycles/frame", "instr/f", "ipc",
+        "cache miss/f", "branch miss/f", "cache/ent", "branch/ent");
+    double per_entity = entities > 0 ? 1.0 / entities : 0.0;
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        const uint64_t* v = totals[p].values;
+        if (v[PERF_CYCLES] == 0) {
+            continue;
+        }
+        fprintf(out, "  %-8s %12.0f %8.0f %6.2f %14.1f %14.1f %12.3f %12.3f\n", PERF_PHASE_NAMES[p],
+            (double)v[PERF_CYCLES] / frames, (double)v[PERF_INSTRUCTIONS] / frames,
+            (double)v[PERF_INSTRUCTIONS] / v[PERF_CYCLES],
+            (double)v[PERF_CACHE_MISSES] / frames, (double)v[PERF_BRANCH_MISSES] / frames,
+            v[PERF_CACHE_MISSES] * per_entity, v[PERF_BRANCH_MISSES] * per_entity);
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+// Parts of a frame measured by perf_counters_t.
+enum perf_phase_e {
+    PHASE_UPDATE,
+    PHASE_GATHER,
+    PHASE_SORT,
+    PHASE_DRAW,     // submitting draw calls, windowed only
+    PHASE_COUNT
+};
+
+extern const char* const PERF_PHASE_NAMES[PHASE_COUNT];
+
+enum perf_event_e {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_EVENT_COUNT
+};
+
+struct perf_sample_t {
+    uint64_t values[PERF_EVENT_COUNT];
+};
+
+// Hardware counters of the calling thread per frame phase, read through
+// perf_event_open on Linux. Elsewhere, or when the kernel refuses (see
+// /proc/sys/kernel/perf_event_paranoid), open() fails and the rest is a no-op,
+// as it is before open() is called.
+class perf_counters_t {
+public:
+    // Summed over every frame, and the last frame on its own.
+    perf_sample_t totals[PHASE_COUNT] = {};
+    perf_sample_t last[PHASE_COUNT] = {};
+    uint64_t frames = 0;
+    // Sprites gathered over all frames, misses are reported per sprite.
+    uint64_t entities = 0;
+
+    perf_counters_t() {}
+    perf_counters_t(const perf_counters_t&) = delete;
+    perf_counters_t& operator=(const perf_counters_t&) = delete;
+    ~perf_counters_t();
+
+    bool open();
+
+    void close();
+
+    bool is_open() const {
+        return group_fd != -1;
+    }
+
+    void begin(perf_phase_e phase);
+
+    void end(perf_phase_e phase);
+
+    // Closes a frame in which entity_count sprites were gathered.
+    void end_frame(size_t entity_count);
+
+    // IPC and misses per frame and per entity for every phase that ran.
+    void report(FILE* out) const;
+
+private:
+    int group_fd = -1;
+    int fds[PERF_EVENT_COUNT] = {-1, -1, -1, -1};
+    perf_sample_t start[PHASE_COUNT] = {};
+    perf_sample_t current[PHASE_COUNT] = {};
+
+    bool read(perf_sample_t* sample) const;
+};
+
+// Measures a phase until the end of the scope.
+class perf_scope_t {
+public:
+    perf_scope_t(perf_counters_t& counters, perf_phase_e phase)
+    : counters(counters), phase(phase) {
+        counters.begin(phase);
+    }
+
+    perf_scope_t(const perf_scope_t&) = delete;
+    perf_scope_t& operator=(const perf_scope_t&) = delete;
+
+    ~perf_scope_t() {
+        counters.end(phase);
+    }
+
+private:
+    perf_counters_t& counters;
+    perf_phase_e phase;
+};
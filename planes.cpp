@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <cstdlib>
+#include "planes.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PLANES_SSE2
+#endif
+
+using namespace std;
+
+// Words combined per pass of count() and find_nearest().
+static const int SPAN_WORDS = 32;
+
+static int popcount64(uint64_t word) {
+    return __builtin_popcountll(word);
+}
+
+static int lowest_bit(uint64_t word) {
+    return __builtin_ctzll(word);
+}
+
+static int highest_bit(uint64_t word) {
+    return 63 - __builtin_clzll(word);
+}
+
+// Bits x0 & 63 and up of the first word, up to x1 & 63 of the last.
+static uint64_t first_mask(int x0) {
+    return ~0ull << (x0 & 63);
+}
+
+static uint64_t last_mask(int x1) {
+    return (x1 & 63) == 63 ? ~0ull : (1ull << ((x1 & 63) + 1)) - 1;
+}
+
+void tile_planes_t::resize(int width, int height) {
+    this->width = width;
+    this->height = height;
+    stride = (width + 63) / 64;
+    version++;
+    for (int p = 0; p < PLANE_COUNT; p++) {
+        planes[p].assign((size_t)stride * height, 0);
+    }
+}
+
+void tile_planes_t::fill(tile_plane_e plane) {
+    version++;
+    // Padding bits past width stay clear, exclude-only queries rely on it.
+    for (int y = 0; y < height; y++) {
+        uint64_t* row = &planes[plane][(size_t)y * stride];
+        fill_n(row, stride, ~0ull);
+        row[stride - 1] &= last_mask(width - 1);
+    }
+}
+
+void tile_planes_t::combine(tile_query_t query, int y, int w0, int w1, uint64_t* out) const {
+    size_t base = (size_t)y * stride;
+    int w = w0;
+
+#if defined(__AVX2__)
+    for (; w + 3 <= w1; w += 4) {
+        __m256i acc = _mm256_set1_epi64x(-1);
+        for (int p = 0; p < PLANE_COUNT; p++) {
+            if (query.require & (1 << p)) {
+                acc = _mm256_and_si256(acc, _mm256_loadu_si256((const __m256i*)&planes[p][base + w]));
+            } else if (query.exclude & (1 << p)) {
+                acc = _mm256_andnot_si256(_mm256_loadu_si256((const __m256i*)&planes[p][base + w]), acc);
+            }
+        }
+        _mm256_storeu_si256((__m256i*)&out[w - w0], acc);
+    }
+#elif defined(PLANES_SSE2)
+    for (; w + 1 <= w1; w += 2) {
+        __m128i acc = _mm_set1_epi32(-1);
+        for (int p = 0; p < PLANE_COUNT; p++) {
+            if (query.require & (1 << p)) {
+                acc = _mm_and_si128(acc, _mm_loadu_si128((const __m128i*)&planes[p][base + w]));
+            } else if (query.exclude & (1 << p)) {
+                acc = _mm_andnot_si128(_mm_loadu_si128((const __m128i*)&planes[p][base + w]), acc);
+            }
+        }
+        _mm_storeu_si128((__m128i*)&out[w - w0], acc);
+    }
+#endif
+
+    for (; w <= w1; w++) {
+        uint64_t acc = ~0ull;
+        for (int p = 0; p < PLANE_COUNT; p++) {
+            if (query.require & (1 << p)) {
+                acc &= planes[p][base + w];
+            } else if (query.exclude & (1 << p)) {
+                acc &= ~planes[p][base + w];
+            }
+        }
+        out[w - w0] = acc;
+    }
+}
+
+size_t tile_planes_t::count(tile_query_t query, int x0, int y0, int x1, int y1) const {
+    x0 = max(x0, 0);
+    y0 = max(y0, 0);
+    x1 = min(x1, width - 1);
+    y1 = min(y1, height - 1);
+    if (x0 > x1 || y0 > y1) {
+        return 0;
+    }
+
+    uint64_t span[SPAN_WORDS];
+    size_t total = 0;
+    for (int y = y0; y <= y1; y++) {
+        for (int w0 = x0 >> 6; w0 <= (x1 >> 6); w0 += SPAN_WORDS) {
+            int w1 = min(w0 + SPAN_WORDS - 1, x1 >> 6);
+            combine(query, y, w0, w1, span);
+            if (w0 == (x0 >> 6)) {
+                span[0] &= first_mask(x0);
+            }
+            if (w1 == (x1 >> 6)) {
+                span[w1 - w0] &= last_mask(x1);
+            }
+            for (int i = 0; i <= w1 - w0; i++) {
+                total += popcount64(span[i]);
+            }
+        }
+    }
+    return total;
+}
+
+int tile_planes_t::scan_right(tile_query_t query, int y, int x, int x1) const {
+    uint64_t span[SPAN_WORDS];
+    for (int w0 = x >> 6; w0 <= (x1 >> 6); w0 += SPAN_WORDS) {
+        int w1 = min(w0 + SPAN_WORDS - 1, x1 >> 6);
+        combine(query, y, w0, w1, span);
+        if (w0 == (x >> 6)) {
+            span[0] &= first_mask(x);
+        }
+        if (w1 == (x1 >> 6)) {
+            span[w1 - w0] &= last_mask(x1);
+        }
+        for (int i = 0; i <= w1 - w0; i++) {
+            if (span[i] != 0) {
+                return (w0 + i) * 64 + lowest_bit(span[i]);
+            }
+        }
+    }
+    return -1;
+}
+
+int tile_planes_t::scan_left(tile_query_t query, int y, int x, int x0) const {
+    uint64_t span[SPAN_WORDS];
+    for (int w1 = x >> 6; w1 >= (x0 >> 6); w1 -= SPAN_WORDS) {
+        int w0 = max(w1 - SPAN_WORDS + 1, x0 >> 6);
+        combine(query, y, w0, w1, span);
+        if (w1 == (x >> 6)) {
+            span[w1 - w0] &= last_mask(x);
+        }
+        if (w0 == (x0 >> 6)) {
+            span[0] &= first_mask(x0);
+        }
+        for (int i = w1 - w0; i >= 0; i--) {
+            if (span[i] != 0) {
+                return (w0 + i) * 64 + highest_bit(span[i]);
+            }
+        }
+    }
+    return -1;
+}
+
+bool tile_planes_t::find_nearest(tile_query_t query, int x, int y, int radius, int* out_x, int* out_y) const {
+    int best = radius + 1;
+    int best_x = -1, best_y = -1;
+
+    // Rows outward from y, each only as wide as a cell in it could still
+    // match or tie the best. Per row only the closest cell on either side
+    // of x can win. Ties go to the upper row, then the left cell.
+    for (int dy = 0; dy <= min(best, radius); dy++) {
+        int reach = min(best, radius) - dy;
+        for (int side = -1; side <= 1; side += 2) {
+            int y_cell = y + side * dy;
+            if ((dy == 0 && side == 1) || y_cell < 0 || y_cell >= height) {
+                continue;
+            }
+            int x0 = max(x - reach, 0), x1 = min(x + reach, width - 1);
+            if (x0 > x1) {
+                continue;
+            }
+
+            int found[2] = {
+                min(x - 1, x1) >= x0 ? scan_left(query, y_cell, min(x - 1, x1), x0) : -1,
+                max(x, x0) <= x1 ? scan_right(query, y_cell, max(x, x0), x1) : -1
+            };
+            for (int x_cell : found) {
+                if (x_cell == -1) {
+                    continue;
+                }
+                int distance = abs(x_cell - x) + dy;
+                if (distance < best || (distance == best && (y_cell < best_y || (y_cell == best_y && x_cell < best_x)))) {
+                    best = distance;
+                    best_x = x_cell;
+                    best_y = y_cell;
+                }
+            }
+        }
+    }
+
+    if (best > radius) {
+        return false;
+    }
+    *out_x = best_x;
+    *out_y = best_y;
+    return true;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Per-cell tile state kept as bitplanes, one bit per cell and rows padded to
+// whole 64-bit words. Queries combine the planes a word (or a SIMD register of
+// words) at a time instead of visiting cells.
+enum tile_plane_e {
+    PLANE_SOLID,     // floor is there: not fallen, or not streamed in yet
+    PLANE_FALLING,   // the tile has started to fall
+    PLANE_TRAPPED,   // the trap slams down here
+    PLANE_OCCUPIED,  // the player stands here
+    PLANE_COUNT
+};
+
+// Cells set in every plane of require and in none of exclude, both bit masks
+// of 1 << tile_plane_e.
+struct tile_query_t {
+    uint8_t require;
+    uint8_t exclude;
+};
+
+// Solid floor that is not giving way and not under the trap.
+constexpr tile_query_t QUERY_WALKABLE = {
+    1 << PLANE_SOLID,
+    (1 << PLANE_FALLING) | (1 << PLANE_TRAPPED)
+};
+
+// Walkable and nobody there yet.
+constexpr tile_query_t QUERY_SAFE = {
+    1 << PLANE_SOLID,
+    (1 << PLANE_FALLING) | (1 << PLANE_TRAPPED) | (1 << PLANE_OCCUPIED)
+};
+
+class tile_planes_t {
+public:
+    int width = 0;
+    int height = 0;
+    int stride = 0;
+    // Goes up whenever a bit changes, so query results can be kept until then.
+    uint32_t version = 0;
+
+    void resize(int width, int height);
+
+    // Sets every cell of a plane.
+    void fill(tile_plane_e plane);
+
+    void set(tile_plane_e plane, int x, int y, bool value) {
+        uint64_t& word = planes[plane][(size_t)y * stride + (x >> 6)];
+        uint64_t bit = 1ull << (x & 63);
+        uint64_t old = word;
+        word = value ? word | bit : word & ~bit;
+        version += word != old;
+    }
+
+    bool get(tile_plane_e plane, int x, int y) const {
+        return (planes[plane][(size_t)y * stride + (x >> 6)] >> (x & 63)) & 1;
+    }
+
+    // Writes the query's result for words w0..w1 of row y to out.
+    void combine(tile_query_t query, int y, int w0, int w1, uint64_t* out) const;
+
+    // Cells matching the query in [x0, x1] x [y0, y1], clamped to the map.
+    size_t count(tile_query_t query, int x0, int y0, int x1, int y1) const;
+
+    // Closest matching cell by Manhattan distance within radius of x, y.
+    bool find_nearest(tile_query_t query, int x, int y, int radius, int* out_x, int* out_y) const;
+
+private:
+    std::vector<uint64_t> planes[PLANE_COUNT];
+
+    // First matching cell of row y in [x, x1], -1 for none.
+    int scan_right(tile_query_t query, int y, int x, int x1) const;
+
+    // Last matching cell of row y in [x0, x], -1 for none.
+    int scan_left(tile_query_t query, int y, int x, int x0) const;
+};
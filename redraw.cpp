@@ -0,0 +1,24 @@
+#include "redraw.h"
+
+using namespace std;
+
+static bool is_same_camera(const Camera2D& a, const Camera2D& b) {
+    return a.offset.x == b.offset.x && a.offset.y == b.offset.y
+        && a.target.x == b.target.x && a.target.y == b.target.y
+        && a.rotation == b.rotation && a.zoom == b.zoom;
+}
+
+bool redraw_tracker_t::needs_redraw(damage_t& damage, const Camera2D& camera, Rectangle view) {
+    bool is_dirty = !is_enabled || is_invalid || damage.intersects(view)
+        || !is_same_camera(camera, last_camera) || IsWindowResized();
+    damage.clear();
+    is_invalid = false;
+    last_camera = camera;
+
+    if (is_dirty) {
+        drawn_frames++;
+    } else {
+        skipped_frames++;
+    }
+    return is_dirty;
+}
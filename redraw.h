@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <raylib.h>
+#include "baseclasses.h"
+
+// Decides whether a frame has to be drawn or the last one can stay on
+// screen. Nothing is scanned per frame: sprites report their changes to a
+// damage_t as they happen, and a frame is drawn when that damage is in
+// view, the camera moved, the window changed or invalidate() was called.
+class redraw_tracker_t {
+public:
+    // Off draws every frame.
+    bool is_enabled = true;
+    uint64_t drawn_frames = 0;
+    uint64_t skipped_frames = 0;
+
+    // Makes the next frame draw, e.g. after a setting changed.
+    void invalidate() {
+        is_invalid = true;
+    }
+
+    // view is the visible part of the world, in world screen coordinates.
+    // The damage is consumed, whether or not it was in view.
+    bool needs_redraw(damage_t& damage, const Camera2D& camera, Rectangle view);
+
+private:
+    bool is_invalid = true;
+    Camera2D last_camera = {};
+};
@@ -0,0 +1,229 @@
+#include <cstdio>
+#include <chrono>
+#include <raylib.h>
+#include "replay.h"
+#include "game.h"
+#include "alloc_tracker.h"
+#include "perf_counters.h"
+#include "hitch.h"
+
+using namespace std;
+
+void input_log_t::record(uint32_t frame, int input) {
+    if (frame + 1 > frame_count) {
+        frame_count = frame + 1;
+    }
+
+    if (input == INPUT_NONE) {
+        return;
+    }
+
+    events.push_back((input_event_t){.frame = frame, .input = input});
+}
+
+static void write_varint(FILE* file, uint64_t value) {
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        if (value != 0) {
+            byte |= 0x80;
+        }
+        fputc(byte, file);
+    } while (value != 0);
+}
+
+static bool read_varint(FILE* file, uint64_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int byte = fgetc(file);
+        if (byte == EOF) {
+            return false;
+        }
+        *value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool input_log_t::save(const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        TraceLog(LOG_ERROR, "Failed to open input log %s for writing.", path);
+        return false;
+    }
+
+    input_log_header_t header = {
+        .magic = INPUT_LOG_MAGIC,
+        .version = INPUT_LOG_VERSION,
+        .tick_rate = tick_rate,
+        .seed = seed,
+        .frame_count = frame_count,
+        .event_count = (uint32_t)events.size()
+    };
+    fwrite(&header, sizeof(header), 1, file);
+
+    uint32_t prev_frame = 0;
+    for (size_t i = 0; i < events.size(); i++) {
+        uint64_t delta = events[i].frame - prev_frame;
+        write_varint(file, (delta << 2) | (uint64_t)events[i].input);
+        prev_frame = events[i].frame;
+    }
+
+    bool ok = ferror(file) == 0;
+    fclose(file);
+    return ok;
+}
+
+bool input_log_t::load(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) {
+        TraceLog(LOG_ERROR, "Failed to open input log %s.", path);
+        return false;
+    }
+
+    input_log_header_t header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != INPUT_LOG_MAGIC || header.version != INPUT_LOG_VERSION) {
+        TraceLog(LOG_ERROR, "%s is not a valid input log.", path);
+        fclose(file);
+        return false;
+    }
+
+    seed = header.seed;
+    tick_rate = header.tick_rate;
+    frame_count = header.frame_count;
+    events.clear();
+    events.reserve(header.event_count);
+
+    uint32_t frame = 0;
+    for (uint32_t i = 0; i < header.event_count; i++) {
+        uint64_t packed;
+        if (!read_varint(file, &packed)) {
+            TraceLog(LOG_ERROR, "Input log %s is truncated.", path);
+            fclose(file);
+            return false;
+        }
+        frame += (uint32_t)(packed >> 2);
+        events.push_back((input_event_t){.frame = frame, .input = (int)(packed & 3)});
+    }
+
+    fclose(file);
+    return true;
+}
+
+int input_log_reader_t::input_at(uint32_t frame) {
+    while (next < log->events.size() && log->events[next].frame < frame) {
+        next++;
+    }
+
+    if (next < log->events.size() && log->events[next].frame == frame) {
+        return log->events[next++].input;
+    }
+    return INPUT_NONE;
+}
+
+int run_replay(const char* path, const replay_options_t& options) {
+    input_log_t log;
+    if (!log.load(path)) {
+        return 1;
+    }
+
+    const float dt = 1.0f / log.tick_rate;
+    frame_arena_t frame_arena;
+    alloc_frame_stats_t alloc_stats;
+    perf_counters_t perf;
+    if (options.use_perf && !perf.open()) {
+        printf("perf counters unavailable, replaying without them\n");
+    }
+    hitch_detector_t hitches;
+    if (options.hitch_ms > 0.0f && !hitches.open(options.hitch_log, options.hitch_ms)) {
+        printf("can't open %s, replaying without a hitch log\n", options.hitch_log);
+    }
+    uint32_t checksum = 0;
+    uint64_t total_frames = 0;
+
+    auto start = chrono::steady_clock::now();
+    for (int run = 0; run < options.repeat; run++) {
+        game_t game(log.seed, options.level_path, options.streamed);
+        if (!game.is_loaded()) {
+            return 1;
+        }
+        input_log_reader_t reader(&log);
+        // Loading the game is not a frame.
+        alloc_stats = alloc_frame_stats_t();
+        hitches.restart_frame();
+
+        for (uint32_t frame = 0; frame < log.frame_count; frame++) {
+            {
+                alloc_scope_t scope(ALLOC_SIM);
+                perf_scope_t perf_scope(perf, PHASE_UPDATE);
+                hitch_scope_t hitch_scope(hitches, PHASE_UPDATE);
+                game.step(dt, reader.input_at(frame));
+            }
+            size_t sprite_count;
+            {
+                sprite_list_t sprites(&frame_arena);
+                {
+                    alloc_scope_t scope(ALLOC_GATHER);
+                    perf_scope_t perf_scope(perf, PHASE_GATHER);
+                    hitch_scope_t hitch_scope(hitches, PHASE_GATHER);
+                    game.gather(sprites);
+                }
+                alloc_scope_t scope(ALLOC_SORT);
+                perf_scope_t perf_scope(perf, PHASE_SORT);
+                hitch_scope_t hitch_scope(hitches, PHASE_SORT);
+                sort_sprites(sprites, &frame_arena);
+                sprite_count = sprites.size();
+            }
+            frame_arena.reset();
+            alloc_stats.end_frame();
+            perf.end_frame(sprite_count);
+
+            frame_record_t& record = hitches.current();
+            record.frame = game.frame;
+            record.dt_ms = dt * 1000.0f;
+            record.actives = (uint32_t)game.actives.members.size();
+            record.live_tiles = (uint32_t)game.live_tiles.size();
+            record.sprites = (uint32_t)sprite_count;
+            record.allocs = alloc_stats.frame_total;
+            hitches.end_frame();
+        }
+
+        checksum = game.checksum();
+        total_frames += log.frame_count;
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    printf("replay: %s\n", path);
+    printf("  seed %u, %u frames, %zu inputs, %d runs\n", log.seed, log.frame_count, log.events.size(), options.repeat);
+    printf("  %.3f s, %.0f frames/s, %.3f us/frame\n", elapsed, total_frames / elapsed, elapsed * 1e6 / total_frames);
+    printf("  checksum %08x\n", checksum);
+    if (perf.is_open()) {
+        perf.report(stdout);
+    }
+    if (hitches.is_open()) {
+        printf("  %u frames over %.2f ms, logged to %s\n", hitches.hitch_count, hitches.threshold_ms, options.hitch_log);
+    }
+    if (ALLOC_TRACKING && alloc_stats.frames > 0) {
+        // Counted over the last run.
+        uint64_t allocs = 0;
+        for (int t = 0; t < ALLOC_TAG_COUNT; t++) {
+            allocs += alloc_stats.total[t];
+        }
+        printf("  allocs: %.3f/frame, worst frame %llu, %llu of %llu frames clean\n",
+            (double)allocs / alloc_stats.frames, (unsigned long long)alloc_stats.worst_frame,
+            (unsigned long long)alloc_stats.clean_frames, (unsigned long long)alloc_stats.frames);
+        for (int t = 0; t < ALLOC_TAG_COUNT; t++) {
+            if (alloc_stats.total[t] > 0) {
+                printf("    %-8s %llu\n", ALLOC_TAG_NAMES[t], (unsigned long long)alloc_stats.total[t]);
+            }
+        }
+        printf("  heap: %lld KB live, %lld KB peak\n", (long long)alloc_stats.live_bytes / 1024, (long long)alloc_stats.peak_bytes / 1024);
+        if (options.alloc_budget >= 0 && alloc_stats.worst_frame > (uint64_t)options.alloc_budget) {
+            printf("  over the budget of %d allocations per frame\n", options.alloc_budget);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "game.h"
+
+// Binary input log: a fixed header followed by one varint per input event.
+// Each event packs the number of frames since the previous event and the
+// movedir_e pressed on that frame as (delta << 2) | dir.
+constexpr uint32_t INPUT_LOG_MAGIC = 0x50455249; // "IREP"
+constexpr uint16_t INPUT_LOG_VERSION = 1;
+
+struct input_log_header_t {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t tick_rate;
+    uint32_t seed;
+    uint32_t frame_count;
+    uint32_t event_count;
+};
+
+struct input_event_t {
+    uint32_t frame;
+    int input;
+};
+
+class input_log_t {
+public:
+    uint32_t seed = 0;
+    uint16_t tick_rate = TICK_RATE;
+    uint32_t frame_count = 0;
+    std::vector<input_event_t> events;
+
+    // Called once per simulated frame with whatever input the game received.
+    void record(uint32_t frame, int input);
+
+    bool save(const char* path);
+
+    bool load(const char* path);
+};
+
+// Walks the events of a log frame by frame.
+class input_log_reader_t {
+private:
+    const input_log_t* log;
+    size_t next = 0;
+public:
+    input_log_reader_t(const input_log_t* log) : log(log) {}
+
+    int input_at(uint32_t frame);
+};
+
+struct replay_options_t {
+    // Runs of the whole log, at least 1.
+    int repeat = 1;
+    const char* level_path = nullptr;
+    bool streamed = false;
+    // Built with TRACK_ALLOCS, a frame allocating more often than this fails
+    // the replay. Negative for no budget.
+    int alloc_budget = -1;
+    // Reports hardware counters per phase where the platform has them.
+    bool use_perf = false;
+    // Frames taking longer are logged to hitch_log, 0 for no hitch log.
+    float hitch_ms = 0.0f;
+    const char* hitch_log = "hitches.log";
+};
+
+// Replays a log headlessly at max speed: simulation, sprite gathering and
+// sorting run exactly as in the windowed game, drawing is skipped.
+// Prints throughput and a state checksum to compare builds, returns 0 on success.
+// Streamed levels depend on chunk load timing, so only their throughput is comparable.
+// Built with TRACK_ALLOCS it also reports allocations per frame.
+int run_replay(const char* path, const replay_options_t& options);
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include "server.h"
+#include "alloc_tracker.h"
+
+using namespace std;
+
+match_server_t::match_server_t(int thread_count) {
+    if (thread_count <= 0) {
+        thread_count = max(1, (int)thread::hardware_concurrency());
+    }
+    for (int i = 1; i < thread_count; i++) {
+        workers.push_back(thread(&match_server_t::worker_main, this));
+    }
+}
+
+match_server_t::~match_server_t() {
+    {
+        lock_guard<mutex> lock(pool_mutex);
+        is_running = false;
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+int match_server_t::add_match(uint32_t seed, const char* level_path) {
+    match_t match;
+    match.game = make_unique<game_t>(seed, level_path);
+    if (!match.game->is_loaded()) {
+        return -1;
+    }
+    matches.push_back(move(match));
+    return (int)matches.size() - 1;
+}
+
+void match_server_t::advance(uint32_t ticks) {
+    if (ticks == 0 || matches.empty()) {
+        return;
+    }
+
+    {
+        lock_guard<mutex> lock(pool_mutex);
+        job_ticks = ticks;
+        next_match = 0;
+        busy_workers = (int)workers.size();
+        generation++;
+    }
+    wake.notify_all();
+
+    run_batches();
+
+    unique_lock<mutex> lock(pool_mutex);
+    done.wait(lock, [this] { return busy_workers == 0; });
+}
+
+uint64_t match_server_t::total_ticks() const {
+    uint64_t total = 0;
+    for (size_t i = 0; i < matches.size(); i++) {
+        total += matches[i].ticks;
+    }
+    return total;
+}
+
+void match_server_t::worker_main() {
+    uint64_t seen = 0;
+    while (true) {
+        {
+            unique_lock<mutex> lock(pool_mutex);
+            wake.wait(lock, [this, seen] { return !is_running || generation != seen; });
+            if (!is_running) {
+                return;
+            }
+            seen = generation;
+        }
+
+        run_batches();
+
+        {
+            lock_guard<mutex> lock(pool_mutex);
+            busy_workers--;
+        }
+        done.notify_one();
+    }
+}
+
+void match_server_t::run_batches() {
+    alloc_scope_t scope(ALLOC_SIM);
+    const float dt = 1.0f / TICK_RATE;
+    while (true) {
+        size_t first = next_match.fetch_add(MATCH_BATCH);
+        if (first >= matches.size()) {
+            return;
+        }
+        size_t last = min(first + MATCH_BATCH, matches.size());
+        // All of a match's ticks in one go while its state is in cache.
+        for (size_t i = first; i < last; i++) {
+            match_t& match = matches[i];
+            for (uint32_t t = 0; t < job_ticks; t++) {
+                match.game->step(dt, match.pending_input);
+                match.pending_input = INPUT_NONE;
+            }
+            match.ticks += job_ticks;
+        }
+    }
+}
+
+// Ticks between the bots' decisions, the length of one advance().
+static const uint32_t BOT_INTERVAL = TICK_RATE / 2;
+
+// xorshift32 like game_t::random, kept apart so the bots don't shift the games' rolls.
+static uint32_t next_bot_roll(uint32_t* state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+int run_server(const server_options_t& options) {
+    if (options.matches <= 0 || options.ticks == 0) {
+        printf("server: nothing to run\n");
+        return 1;
+    }
+
+    match_server_t server(options.threads);
+    vector<uint32_t> bots;
+    for (int i = 0; i < options.matches; i++) {
+        uint32_t seed = options.seed + (uint32_t)i;
+        if (server.add_match(seed, options.level_path) == -1) {
+            return 1;
+        }
+        bots.push_back(seed != 0 ? seed : 1);
+    }
+
+    auto start = chrono::steady_clock::now();
+    for (uint32_t tick = 0; tick < options.ticks; tick += BOT_INTERVAL) {
+        // Half of the time a bot stands still, otherwise it hops one way.
+        for (size_t i = 0; i < server.matches.size(); i++) {
+            uint32_t roll = next_bot_roll(&bots[i]) % 8;
+            server.queue_input(i, roll < 4 ? (int)roll : INPUT_NONE);
+        }
+        server.advance(min(BOT_INTERVAL, options.ticks - tick));
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    uint32_t checksum = 2166136261u;
+    for (size_t i = 0; i < server.matches.size(); i++) {
+        checksum = (checksum ^ server.matches[i].game->checksum()) * 16777619u;
+    }
+
+    uint64_t ticks = server.total_ticks();
+    printf("server: %d matches, %u ticks each, %d threads\n", options.matches, options.ticks, server.thread_count());
+    printf("  %.3f s, %.0f ticks/s, %.0f ticks/s per thread, %.3f us/tick\n", elapsed, ticks / elapsed,
+        ticks / elapsed / server.thread_count(), elapsed * 1e6 / ticks);
+    printf("  %.1f matches at %d Hz per thread\n", ticks / elapsed / server.thread_count() / TICK_RATE, TICK_RATE);
+    printf("  checksum %08x\n", checksum);
+    return 0;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "game.h"
+
+// Matches a worker claims at once. Enough to keep the shared counter from
+// bouncing between cores, few enough to even out matches of uneven cost.
+constexpr size_t MATCH_BATCH = 8;
+
+// A hosted game and the input waiting for its next tick.
+struct match_t {
+    std::unique_ptr<game_t> game;
+    int pending_input = INPUT_NONE;
+    uint64_t ticks = 0;
+};
+
+// Hosts independent games in one process and steps them at fixed
+// 1 / TICK_RATE steps on a pool of worker threads. Each game owns its map,
+// player, trap and RNG, and a match is stepped by a single thread at a
+// time, so the games never synchronize with each other.
+class match_server_t {
+public:
+    std::vector<match_t> matches;
+
+    // thread_count counts the calling thread, 0 for one per hardware thread.
+    match_server_t(int thread_count = 0);
+    match_server_t(const match_server_t&) = delete;
+    match_server_t& operator=(const match_server_t&) = delete;
+    ~match_server_t();
+
+    int thread_count() const {
+        return (int)workers.size() + 1;
+    }
+
+    // Level files are mapped per match, streaming isn't supported here.
+    // Returns the match's index, or -1 when the level failed to load.
+    int add_match(uint32_t seed, const char* level_path = nullptr);
+
+    // Input for the match's next tick, outside of advance().
+    void queue_input(size_t match, int input) {
+        matches[match].pending_input = input;
+    }
+
+    // Steps every match ticks times and returns once all of them are done.
+    // The calling thread works through matches alongside the pool.
+    void advance(uint32_t ticks);
+
+    uint64_t total_ticks() const;
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex pool_mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    // Bumped by advance() for every job handed to the workers.
+    uint64_t generation = 0;
+    uint32_t job_ticks = 0;
+    int busy_workers = 0;
+    bool is_running = true;
+    std::atomic<size_t> next_match{0};
+
+    void worker_main();
+
+    // Claims MATCH_BATCH matches at a time and steps them until none are left.
+    void run_batches();
+};
+
+struct server_options_t {
+    int matches = 64;
+    int threads = 0;
+    uint32_t ticks = TICK_RATE * 60;
+    uint32_t seed = 1;
+    const char* level_path = nullptr;
+};
+
+// Hosts options.matches games headlessly, each driven by a random bot, and
+// runs them for options.ticks ticks as fast as the pool allows. Prints the
+// aggregate ticks per second and a checksum over all matches, which doesn't
+// depend on the thread count. Returns 0 on success.
+int run_server(const server_options_t& options);
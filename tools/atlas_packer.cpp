@@ -0,0 +1,282 @@
+// Offline atlas packer: cuts named frames out of source images, trims their
+// transparent borders and shelf-packs them into a single texture, writing the
+// packed png and the binary metadata read by atlas_t::load_meta.
+//
+// usage: atlas_packer <manifest> <out.png> <out.meta>
+//
+// Manifest lines (paths are relative to the manifest, '#' starts a comment):
+//   image <path> <cell_w> <cell_h>       source grid used by the following frames
+//   frame <name> <cell>                  one named frame cut from a grid cell
+//   frames <prefix> <first_cell> <count> prefix_0 .. prefix_<count-1> from consecutive cells
+//   anim <name> <loop|once> <duration_ms> <frame>...
+//                                        a frame given as <frame>:<ms> overrides its duration,
+//                                        e.g. :0 for a final pose that is held
+// Frames keep their manifest order as atlas indices, only their placement changes.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <raylib.h>
+#include "../atlas.h"
+
+using namespace std;
+
+constexpr int PADDING = 1;
+constexpr int MAX_SIZE = 4096;
+
+struct source_t {
+    string path;
+    Image image;
+    int cell_w, cell_h;
+};
+
+struct packed_frame_t {
+    string name;
+    int source;
+    Rectangle cell;
+    Rectangle trimmed;
+    int x = 0, y = 0;
+};
+
+struct packed_anim_t {
+    string name;
+    bool loop;
+    vector<string> frames;
+    vector<int> durations_ms;
+};
+
+static bool parse_manifest(const char* path, vector<source_t>& sources, vector<packed_frame_t>& frames, vector<packed_anim_t>& anims) {
+    ifstream file(path);
+    if (!file) {
+        fprintf(stderr, "Failed to open manifest %s\n", path);
+        return false;
+    }
+
+    string dir = GetDirectoryPath(path);
+    string line;
+    int line_no = 0;
+    while (getline(file, line)) {
+        line_no++;
+        line = line.substr(0, line.find('#'));
+        istringstream in(line);
+        string cmd;
+        if (!(in >> cmd)) {
+            continue;
+        }
+
+        if (cmd == "image") {
+            source_t source;
+            in >> source.path >> source.cell_w >> source.cell_h;
+            source.image = LoadImage((dir + "/" + source.path).c_str());
+            if (source.image.data == nullptr) {
+                fprintf(stderr, "%s:%d: failed to load %s\n", path, line_no, source.path.c_str());
+                return false;
+            }
+            ImageFormat(&source.image, PIXELFORMAT_UNCOMPRESSED_R8G8B8A8);
+            sources.push_back(source);
+        } else if (cmd == "frame" || cmd == "frames") {
+            if (sources.empty()) {
+                fprintf(stderr, "%s:%d: frame before any image\n", path, line_no);
+                return false;
+            }
+            string name;
+            int first = 0, count = 1;
+            in >> name >> first;
+            if (cmd == "frames") {
+                in >> count;
+            }
+
+            const source_t& source = sources.back();
+            int cells_x = source.image.width / source.cell_w;
+            for (int i = 0; i < count; i++) {
+                packed_frame_t frame;
+                frame.name = cmd == "frames" ? name + "_" + to_string(i) : name;
+                frame.source = (int)sources.size() - 1;
+                frame.cell = (Rectangle){
+                    (float)(((first + i) % cells_x) * source.cell_w),
+                    (float)(((first + i) / cells_x) * source.cell_h),
+                    (float)source.cell_w,
+                    (float)source.cell_h
+                };
+                frames.push_back(frame);
+            }
+        } else if (cmd == "anim") {
+            packed_anim_t anim;
+            string mode;
+            int duration_ms = 0;
+            in >> anim.name >> mode >> duration_ms;
+            anim.loop = mode == "loop";
+            string frame;
+            while (in >> frame) {
+                size_t colon = frame.find(':');
+                anim.frames.push_back(frame.substr(0, colon));
+                anim.durations_ms.push_back(colon != string::npos ? atoi(frame.c_str() + colon + 1) : duration_ms);
+            }
+            anims.push_back(anim);
+        } else {
+            fprintf(stderr, "%s:%d: unknown command %s\n", path, line_no, cmd.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+// Shelf packing by decreasing height, doubling the texture until everything fits.
+static bool pack(vector<packed_frame_t>& frames, int* width, int* height) {
+    vector<int> order(frames.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        order[i] = (int)i;
+    }
+    sort(order.begin(), order.end(), [&frames](int a, int b) {
+        return frames[a].trimmed.height > frames[b].trimmed.height;
+    });
+
+    for (int size = 64; size <= MAX_SIZE; size *= 2) {
+        int x = 0, y = 0, shelf_h = 0;
+        bool fits = true;
+        for (int idx : order) {
+            packed_frame_t& frame = frames[idx];
+            int w = (int)frame.trimmed.width + PADDING;
+            int h = (int)frame.trimmed.height + PADDING;
+            if (x + w > size) {
+                x = 0;
+                y += shelf_h;
+                shelf_h = 0;
+            }
+            if (w > size || y + h > size) {
+                fits = false;
+                break;
+            }
+            frame.x = x;
+            frame.y = y;
+            x += w;
+            shelf_h = max(shelf_h, h);
+        }
+
+        if (fits) {
+            *width = size;
+            *height = size;
+            // Trim unused shelves off the bottom, keeping a power of two.
+            while (*height > 64 && y + shelf_h <= *height / 2) {
+                *height /= 2;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+template<typename T>
+static void write(FILE* file, T value) {
+    fwrite(&value, sizeof(T), 1, file);
+}
+
+static void write_name(FILE* file, const string& name) {
+    write<uint8_t>(file, (uint8_t)name.size());
+    fwrite(name.data(), 1, name.size(), file);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 4) {
+        fprintf(stderr, "usage: %s <manifest> <out.png> <out.meta>\n", argv[0]);
+        return 1;
+    }
+    SetTraceLogLevel(LOG_WARNING);
+
+    vector<source_t> sources;
+    vector<packed_frame_t> frames;
+    vector<packed_anim_t> anims;
+    if (!parse_manifest(argv[1], sources, frames, anims)) {
+        return 1;
+    }
+
+    for (packed_frame_t& frame : frames) {
+        Image cell = ImageFromImage(sources[frame.source].image, frame.cell);
+        frame.trimmed = GetImageAlphaBorder(cell, 0.0f);
+        UnloadImage(cell);
+        // Fully transparent cells still get a texel so every index stays drawable.
+        if (frame.trimmed.width == 0 || frame.trimmed.height == 0) {
+            frame.trimmed = (Rectangle){0, 0, 1, 1};
+        }
+    }
+
+    int width = 0, height = 0;
+    if (!pack(frames, &width, &height)) {
+        fprintf(stderr, "Frames do not fit into %dx%d\n", MAX_SIZE, MAX_SIZE);
+        return 1;
+    }
+
+    Image packed = GenImageColor(width, height, BLANK);
+    for (const packed_frame_t& frame : frames) {
+        Rectangle src = frame.trimmed;
+        src.x += frame.cell.x;
+        src.y += frame.cell.y;
+        ImageDraw(&packed, sources[frame.source].image, src, (Rectangle){(float)frame.x, (float)frame.y, src.width, src.height}, WHITE);
+    }
+    if (!ExportImage(packed, argv[2])) {
+        fprintf(stderr, "Failed to write %s\n", argv[2]);
+        return 1;
+    }
+    UnloadImage(packed);
+
+    FILE* file = fopen(argv[3], "wb");
+    if (file == nullptr) {
+        fprintf(stderr, "Failed to write %s\n", argv[3]);
+        return 1;
+    }
+
+    string texture_name = GetFileName(argv[2]);
+    atlas_meta_header_t header = {
+        .magic = ATLAS_META_MAGIC,
+        .version = ATLAS_META_VERSION,
+        .frame_count = (uint16_t)frames.size(),
+        .anim_count = (uint16_t)anims.size(),
+        .texture_name_len = (uint16_t)texture_name.size()
+    };
+    write(file, header);
+    fwrite(texture_name.data(), 1, texture_name.size(), file);
+
+    for (const packed_frame_t& frame : frames) {
+        write_name(file, frame.name);
+        write<uint16_t>(file, frame.x);
+        write<uint16_t>(file, frame.y);
+        write<uint16_t>(file, frame.trimmed.width);
+        write<uint16_t>(file, frame.trimmed.height);
+        write<uint16_t>(file, frame.cell.width);
+        write<uint16_t>(file, frame.cell.height);
+        write<int16_t>(file, -frame.trimmed.x);
+        write<int16_t>(file, -frame.trimmed.y);
+    }
+
+    for (const packed_anim_t& anim : anims) {
+        write_name(file, anim.name);
+        write<uint8_t>(file, anim.loop);
+        write<uint16_t>(file, anim.frames.size());
+        for (size_t i = 0; i < anim.frames.size(); i++) {
+            const string& name = anim.frames[i];
+            auto it = find_if(frames.begin(), frames.end(), [&name](const packed_frame_t& frame) {
+                return frame.name == name;
+            });
+            if (it == frames.end()) {
+                fprintf(stderr, "Animation %s references unknown frame %s\n", anim.name.c_str(), name.c_str());
+                fclose(file);
+                return 1;
+            }
+            write<uint16_t>(file, it - frames.begin());
+            write<uint16_t>(file, anim.durations_ms[i]);
+        }
+    }
+    fclose(file);
+
+    for (source_t& source : sources) {
+        UnloadImage(source.image);
+    }
+
+    printf("Packed %zu frames and %zu animations into %dx%d %s\n", frames.size(), anims.size(), width, height, argv[2]);
+    return 0;
+}